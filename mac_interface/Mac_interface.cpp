@@ -7,6 +7,7 @@
 #include <exception>
 
 #include "Environment.hpp"
+#include "Heuristic_Cache.hpp"
 #include "State.hpp"
 #include "Planner_Mac.hpp"
 #include "Planner.hpp"
@@ -18,6 +19,8 @@ std::vector<Planner> planners;
 std::map<size_t, int> planner_map;
 State state;
 size_t seed;
+size_t max_coalition_size;
+size_t time_budget;
 int mac_agents;
 
 //std::vector<Direction> fixed_actions{ Direction::DOWN, Direction::LEFT, Direction::UP, Direction::RIGHT };
@@ -90,12 +93,27 @@ PyObject* mac_init(PyObject*, PyObject* o) {
 
 	seed = PyLong_AsLong(PyDict_GetItemString(o, "seed"));
 
+	// Optional, unbounded coalitions by default
+	auto max_coalition_size_obj = PyDict_GetItemString(o, "max_coalition_size");
+	max_coalition_size = max_coalition_size_obj == nullptr ? EMPTY_VAL : PyLong_AsLong(max_coalition_size_obj);
+
+	// Optional planning time per step in milliseconds, no budget by default
+	auto time_budget_obj = PyDict_GetItemString(o, "time_budget");
+	time_budget = time_budget_obj == nullptr ? 0 : PyLong_AsLong(time_budget_obj);
+
+	// Optional directory of persisted heuristic tables, not persisted by default
+	auto heuristic_cache_obj = PyDict_GetItemString(o, "heuristic_cache_dir");
+	if (heuristic_cache_obj != nullptr) {
+		auto heuristic_cache_dir = to_string(heuristic_cache_obj);
+		set_heuristic_cache_directory(std::string(heuristic_cache_dir.begin() + 1, heuristic_cache_dir.end() - 1));
+	}
+
 	return PyLong_FromLong(2);
 }
 
 PyObject* mac_add_agent(PyObject*, PyObject* o) {
 	size_t agent_id = (size_t)PyLong_AsLong(PyDict_GetItemString(o, "agent_id"));
-	planners.emplace_back(std::make_unique<Planner_Mac>(environment, agent_id, state, seed));
+	planners.emplace_back(std::make_unique<Planner_Mac>(environment, agent_id, state, seed, max_coalition_size, time_budget));
 	mac_agents++;
 	planner_map.emplace(agent_id, mac_agents);
 
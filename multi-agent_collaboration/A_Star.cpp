@@ -1,11 +1,14 @@
 #include "A_Star.hpp"
 #include "Search.hpp"
+#include "Reservation_Table.hpp"
 #include <queue>
+#include <type_traits>
 #include <unordered_set>
 #include <iostream>
 
 
-A_Star::A_Star(const Environment& environment, size_t depth_limit) 
+template <typename Heuristic_Policy>
+A_Star_Search<Heuristic_Policy>::A_Star_Search(const Environment& environment, size_t depth_limit) 
 	: Search_Method(environment, depth_limit), dist_heuristic(environment), heuristic(environment) {
 }
 /**
@@ -17,7 +20,8 @@ input_actions	Fixed initial actions for agents not in free_agents
 free_agents		Agents allowed any move any time
 */
 
-std::vector<Joint_Action> A_Star::search_joint(const State& original_state,
+template <typename Heuristic_Policy>
+std::vector<Joint_Action> A_Star_Search<Heuristic_Policy>::search_joint(const State& original_state,
 		Recipe recipe, const Agent_Combination& agents, Agent_Id handoff_agent, 
 	const std::vector<Joint_Action>& input_actions, const Agent_Combination& free_agents, const Action& initial_action) {
 
@@ -28,12 +32,14 @@ std::vector<Joint_Action> A_Star::search_joint(const State& original_state,
 	
 	auto actions = get_actions(agents, false);
 	Search_Info si = initialize_variables(recipe, original_state, handoff_agent, agents, input_actions);
+	Reservation_Table reservations(environment, original_state, input_actions, free_agents);
 
 	while (!si.has_goal_node()) {
 
 		// No possible path
 		auto *current_node = get_next_node(si);
 		if (current_node == nullptr) {
+			print_heuristic_stats();
 			return {};
 		}
 
@@ -44,11 +50,17 @@ std::vector<Joint_Action> A_Star::search_joint(const State& original_state,
 				continue;
 			}
 
+			// Collides with the fixed input actions
+			if (is_reservation_conflict(current_node, action, reservations)) {
+				continue;
+			}
+
 			// Perform action if valid
 			auto *new_node = check_and_perform(si, action, current_node, input_actions);
 			if (new_node == nullptr) {
 				continue;
 			}
+			new_node->h = heuristic(new_node->state, si.agents, handoff_agent);
 
 			print_current(new_node);
 			if (process_node(si, new_node, action)) {
@@ -64,31 +76,114 @@ std::vector<Joint_Action> A_Star::search_joint(const State& original_state,
 	if (si.goal_node != nullptr) {
 		print_goal(si.goal_node);
 	}
+	print_heuristic_stats();
 	return extract_actions(si.goal_node);
 }
 
-std::pair<size_t, Direction> A_Star::get_dist_direction(Coordinate source, Coordinate dest, size_t walls) {
+/**
+Explores once for all recipes, with the smallest heuristic value over the recipes not found yet. The first
+generated goal node of each recipe is kept, like in search_joint, and goal nodes are expanded further as
+they may lie on the path to other recipes. Heuristic values of queued nodes are not raised when a recipe is
+found. Pass nodes depend on the recipe ingredients, so searches with a handoff agent are done per recipe.
+*/
+template <typename Heuristic_Policy>
+std::map<Recipe, std::vector<Joint_Action>> A_Star_Search<Heuristic_Policy>::search_joint_multi(const State& original_state,
+	const std::vector<Recipe>& recipes, const Agent_Combination& agents, Agent_Id handoff_agent) {
+
+	if (handoff_agent.is_not_empty() || recipes.size() < 2) {
+		return Search_Method::search_joint_multi(original_state, recipes, agents, handoff_agent);
+	}
+
+	while (target_heuristics.size() < recipes.size()) {
+		target_heuristics.emplace_back(environment);
+	}
+	for (size_t i = 0; i < recipes.size(); ++i) {
+		target_heuristics.at(i).set(recipes.at(i).ingredient1, recipes.at(i).ingredient2, agents, handoff_agent);
+	}
+	std::vector<bool> found(recipes.size(), false);
+	size_t remaining = recipes.size();
+	auto get_heuristic = [&](const State& state) {
+		size_t h = EMPTY_VAL;
+		for (size_t i = 0; i < recipes.size(); ++i) {
+			if (!found.at(i)) {
+				h = std::min(h, target_heuristics.at(i)(state, agents, handoff_agent));
+			}
+		}
+		return h;
+	};
+
+	auto actions = get_actions(agents, false);
+	Search_Info si(recipes.front(), handoff_agent, agents);
+	si.nodes.emplace_back(original_state, 0, 0, get_heuristic(original_state), 0, EMPTY_VAL, false, EMPTY_VAL,
+		nullptr, Joint_Action(), false, true, Agent_Id());
+	auto* root = &si.nodes.back();
+	root->calculate_hash();
+	si.frontier.push(root);
+	si.visited.insert(root);
+
+	std::map<Recipe, std::vector<Joint_Action>> paths;
+	while (remaining > 0) {
+
+		// No possible path for the remaining recipes
+		auto* current_node = get_next_node(si);
+		if (current_node == nullptr) {
+			break;
+		}
+
+		for (const auto& action : actions) {
+			auto* new_node = check_and_perform(si, action, current_node, {});
+			if (new_node == nullptr) {
+				continue;
+			}
+
+			for (size_t i = 0; i < recipes.size(); ++i) {
+				if (!found.at(i) && new_node->state.contains_item(recipes.at(i).result)) {
+					found.at(i) = true;
+					--remaining;
+					paths.emplace(recipes.at(i), extract_actions(new_node));
+				}
+			}
+			if (remaining == 0) {
+				break;
+			}
+			new_node->h = get_heuristic(new_node->state);
+
+			auto visited_it = si.visited.find(new_node);
+			if (visited_it != si.visited.end()) {
+				replace_visited(si, new_node, visited_it);
+			}
+			else {
+				si.visited.insert(new_node);
+				si.frontier.push(new_node);
+			}
+		}
+	}
+	return paths;
+}
+
+template <typename Heuristic_Policy>
+std::pair<size_t, Direction> A_Star_Search<Heuristic_Policy>::get_dist_direction(Coordinate source, Coordinate dest, size_t walls) {
 	return dist_heuristic.get_dist_direction(source, dest, walls);
 }
 
-bool A_Star::process_node(Search_Info& si, Node* node, const Joint_Action& action) const {
+// Heuristic value of the initial state, from the distance tables regardless of the search policy
+template <typename Heuristic_Policy>
+size_t A_Star_Search<Heuristic_Policy>::estimate_length(const State& state, Recipe recipe,
+	const Agent_Combination& agents, Agent_Id handoff_agent) {
+
+	dist_heuristic.set(recipe.ingredient1, recipe.ingredient2, agents, handoff_agent);
+	return dist_heuristic(state, agents, handoff_agent);
+}
+
+template <typename Heuristic_Policy>
+bool A_Star_Search<Heuristic_Policy>::process_node(Search_Info& si, Node* node, const Joint_Action& action) const {
 	auto& visited = si.visited;
 	auto& frontier = si.frontier;
-	auto& nodes = si.nodes;
 	auto visited_it = visited.find(node);
 
 	// Existing state
 	if (visited_it != visited.end()) {
-		if (node->is_shorter(*visited_it)) {
-			(*visited_it)->valid = false;
-			visited.erase(visited_it);
-			visited.insert(node);
-			frontier.push(node);
-		} else {
-			assert(&nodes.back() == node);
-			nodes.pop_back();
-			return false;
-		}
+		return replace_visited(si, node, visited_it);
 
 		// New state
 	} else {
@@ -111,7 +206,23 @@ bool A_Star::process_node(Search_Info& si, Node* node, const Joint_Action& actio
 	return true;
 }
 
-bool A_Star::action_conforms_to_input(const Node* current_node, const std::vector<Joint_Action>& input_actions,
+// Keeps the node if shorter than the visited node of the same state, the node must be the last created
+template <typename Heuristic_Policy>
+bool A_Star_Search<Heuristic_Policy>::replace_visited(Search_Info& si, Node* node, Node_Set::iterator visited_it) const {
+	if (node->is_shorter(*visited_it)) {
+		(*visited_it)->valid = false;
+		si.visited.erase(visited_it);
+		si.visited.insert(node);
+		si.frontier.push(node);
+		return true;
+	}
+	assert(&si.nodes.back() == node);
+	si.nodes.pop_back();
+	return false;
+}
+
+template <typename Heuristic_Policy>
+bool A_Star_Search<Heuristic_Policy>::action_conforms_to_input(const Node* current_node, const std::vector<Joint_Action>& input_actions,
 	const Joint_Action action, const Agent_Combination& free_agents, const Action& initial_action) const {
 	if (current_node->g == 0 
 		&& initial_action.has_value()
@@ -135,7 +246,27 @@ bool A_Star::action_conforms_to_input(const Node* current_node, const std::vecto
 	return true;
 }
 
-std::vector<Joint_Action> A_Star::extract_actions(const Node* node) const {
+// Rejected by act anyway, but without copying the state
+template <typename Heuristic_Policy>
+bool A_Star_Search<Heuristic_Policy>::is_reservation_conflict(const Node* current_node, const Joint_Action& action,
+	const Reservation_Table& reservations) const {
+	if (current_node->g >= reservations.get_length()) {
+		return false;
+	}
+	for (const auto& single_action : action.actions) {
+		if (reservations.is_reserved(single_action.agent)) {
+			continue;
+		}
+		const auto& current = current_node->state.agents.at(single_action.agent.id).coordinate;
+		if (reservations.is_conflict(current, environment.move(current, single_action.direction), current_node->g)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template <typename Heuristic_Policy>
+std::vector<Joint_Action> A_Star_Search<Heuristic_Policy>::extract_actions(const Node* node) const {
 	std::vector<Joint_Action> result;
 	while (node->parent != nullptr) {
 		if (node->action.is_action_valid()) {
@@ -150,20 +281,23 @@ std::vector<Joint_Action> A_Star::extract_actions(const Node* node) const {
 	return reversed;
 }
 
-bool A_Star::is_invalid_goal(const Search_Info& si, const Node* node, const Joint_Action& action) const {
+template <typename Heuristic_Policy>
+bool A_Star_Search<Heuristic_Policy>::is_invalid_goal(const Search_Info& si, const Node* node, const Joint_Action& action) const {
 	return node->state.contains_item(si.recipe.result) 
 		&& si.handoff_agent.is_not_empty() 
 		&& action.is_not_none(si.handoff_agent);
 }
 
-bool A_Star::is_valid_goal(const Search_Info& si, const Node* node, const Joint_Action& action) const {
+template <typename Heuristic_Policy>
+bool A_Star_Search<Heuristic_Policy>::is_valid_goal(const Search_Info& si, const Node* node, const Joint_Action& action) const {
 	return node->state.contains_item(si.recipe.result)
 		&& (!si.handoff_agent.is_not_empty()
 			|| (node->has_agent_passed() 
 				&& !action.is_not_none(si.handoff_agent)));
 }
 
-Node* A_Star::check_and_perform(Search_Info& si, const Joint_Action& action,
+template <typename Heuristic_Policy>
+Node* A_Star_Search<Heuristic_Policy>::check_and_perform(Search_Info& si, const Joint_Action& action,
 	const Node* current_node, const std::vector<Joint_Action>& input_actions) const {
 	Node_Ref& nodes = si.nodes;
 	auto& handoff_agent = si.handoff_agent;
@@ -189,7 +323,6 @@ Node* A_Star::check_and_perform(Search_Info& si, const Joint_Action& action,
 	new_node->g += 1;
 	new_node->action_count += get_action_cost(action, handoff_agent);
 	new_node->closed = false;
-	new_node->h = heuristic(new_node->state, si.agents, handoff_agent);
 
 	if (handoff_agent.is_not_empty() && action.get_action(handoff_agent).is_not_none()) {
 		new_node->handoff_first_action = std::min(new_node->g, new_node->handoff_first_action);
@@ -201,7 +334,8 @@ Node* A_Star::check_and_perform(Search_Info& si, const Joint_Action& action,
 	return new_node;
 }
 
-Node* A_Star::generate_handoff(Search_Info& si, Node* node, const std::vector<Joint_Action>& input_actions) const {
+template <typename Heuristic_Policy>
+Node* A_Star_Search<Heuristic_Policy>::generate_handoff(Search_Info& si, Node* node, const std::vector<Joint_Action>& input_actions) const {
 	auto& nodes = si.nodes;
 	Node* pass_node = nullptr;
 	if (si.handoff_agent.is_not_empty() 
@@ -220,7 +354,8 @@ Node* A_Star::generate_handoff(Search_Info& si, Node* node, const std::vector<Jo
 	return pass_node;
 }
 
-size_t A_Star::get_action_cost(const Joint_Action& joint_action, const Agent_Id& handoff_agent) const {
+template <typename Heuristic_Policy>
+size_t A_Star_Search<Heuristic_Policy>::get_action_cost(const Joint_Action& joint_action, const Agent_Id& handoff_agent) const {
 	size_t result = 0;
 	for (size_t agent = 0; agent < joint_action.size(); ++agent) {
 		if (!handoff_agent.is_not_empty() || handoff_agent.id != agent) {
@@ -230,7 +365,8 @@ size_t A_Star::get_action_cost(const Joint_Action& joint_action, const Agent_Id&
 	return result;
 }
 
-Search_Info A_Star::initialize_variables(Recipe& recipe, const State& original_state, const Agent_Id& handoff_agent, const Agent_Combination& agents, const std::vector<Joint_Action>& input_actions) const {
+template <typename Heuristic_Policy>
+Search_Info A_Star_Search<Heuristic_Policy>::initialize_variables(Recipe& recipe, const State& original_state, const Agent_Id& handoff_agent, const Agent_Combination& agents, const std::vector<Joint_Action>& input_actions) const {
 
 	Search_Info si(recipe, handoff_agent, agents);
 
@@ -265,11 +401,16 @@ Search_Info A_Star::initialize_variables(Recipe& recipe, const State& original_s
 	return si;
 }
 
-std::vector<Joint_Action> A_Star::get_actions(const Agent_Combination& agents, bool has_handoff_agent) const {
+template <typename Heuristic_Policy>
+std::vector<Joint_Action> A_Star_Search<Heuristic_Policy>::get_actions(const Agent_Combination& agents, bool has_handoff_agent) const {
 	return environment.get_joint_actions(agents);
 }
 
-Node* A_Star::get_next_node(Search_Info& si) const {
+template <typename Heuristic_Policy>
+Node* A_Star_Search<Heuristic_Policy>::get_next_node(Search_Info& si) const {
+	if (is_deadline_passed()) {
+		return nullptr;
+	}
 	while (!si.frontier.empty()) {
 		auto *current_node = si.frontier.top();
 		si.frontier.pop();
@@ -289,7 +430,8 @@ Node* A_Star::get_next_node(Search_Info& si) const {
 	return nullptr;
 }
 
-void A_Star::print_current(const Node* node) const {
+template <typename Heuristic_Policy>
+void A_Star_Search<Heuristic_Policy>::print_current(const Node* node) const {
 	if (!is_print_allowed(Print_Level::VERBOSE)) {
 		return;
 	}
@@ -298,7 +440,8 @@ void A_Star::print_current(const Node* node) const {
 	std::cout << std::endl;
 }
 
-void A_Star::print_goal(const Node* node) const {
+template <typename Heuristic_Policy>
+void A_Star_Search<Heuristic_Policy>::print_goal(const Node* node) const {
 	if (!is_print_allowed(Print_Level::VERBOSE)) {
 		return;
 	}
@@ -308,4 +451,15 @@ void A_Star::print_goal(const Node* node) const {
 		print_goal(node->parent);
 	}
 	print_current(node);
-}
\ No newline at end of file
+}
+
+template <typename Heuristic_Policy>
+void A_Star_Search<Heuristic_Policy>::print_heuristic_stats() const {
+	if constexpr (std::is_same_v<Heuristic_Policy, Heuristic>) {
+		PRINT(Print_Category::A_STAR, Print_Level::VERBOSE, heuristic.get_cache_stats() + "\n");
+	}
+}
+
+template class A_Star_Search<Heuristic>;
+template class A_Star_Search<Manhattan_Heuristic>;
+template class A_Star_Search<Goal_Count_Heuristic>;
@@ -5,6 +5,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <deque>
 #include <queue>
 #include <unordered_set>
 #include <memory>
@@ -16,6 +17,8 @@
 #include "Utils.hpp"
 #include "Heuristic.hpp"
 
+class Reservation_Table;
+
 struct Node {
 	Node() {}
 
@@ -174,14 +177,22 @@ struct Search_Info {
 	Agent_Combination agents;
 };
 
+// Heuristic policies of A_Star_Search provide
+//	Policy(const Environment& environment);
+//	void set(Ingredient ingredient1, Ingredient ingredient2, const Agent_Combination& agents, const Agent_Id& handoff_agent);
+//	size_t operator()(const State& state, const Agent_Combination& agents, const Agent_Id& handoff_agent) const;
+// The wall-aware Heuristic is the default, the cheaper policies below ignore walls and other agents.
+
+// Manhattan distance between the closest ingredient locations
 class Manhattan_Heuristic {
 public:
 	Manhattan_Heuristic(const Environment& environment) : environment(environment),
 		ingredient1(Ingredient::DELIVERY), ingredient2(Ingredient::DELIVERY) { }
 
 	size_t operator()(const State& state, const Agent_Combination& agents, const Agent_Id& handoff_agent) const {
-		std::vector<Location> locations1 = environment.get_locations(state, ingredient1);
+		std::vector<Location> locations1;
 		if (environment.is_type_stationary(ingredient1)) {
+			locations1 = environment.get_locations(state, ingredient1);
 		} else {
 			locations1 = environment.get_non_wall_locations(state, ingredient1);
 		}
@@ -212,15 +223,50 @@ public:
 	Ingredient ingredient2;
 };
 
+// Number of recipe ingredients missing from the state, each needs at least one action to be made
+class Goal_Count_Heuristic {
+public:
+	Goal_Count_Heuristic(const Environment& environment) : environment(environment),
+		ingredient1(Ingredient::DELIVERY), ingredient2(Ingredient::DELIVERY) { }
+
+	size_t operator()(const State& state, const Agent_Combination& agents, const Agent_Id& handoff_agent) const {
+		size_t missing = 0;
+		if (!environment.is_type_stationary(ingredient1) && !state.contains_item(ingredient1)) {
+			++missing;
+		}
+		if (!state.contains_item(ingredient2)) {
+			++missing;
+		}
+		return missing;
+	}
+
+	void set(Ingredient ingredient1, Ingredient ingredient2, const Agent_Combination& agents,
+		const Agent_Id& handoff_agent) {
+
+		this->ingredient1 = ingredient1;
+		this->ingredient2 = ingredient2;
+	}
+
+	Environment environment;
+	Ingredient ingredient1;
+	Ingredient ingredient2;
+};
+
 
-class A_Star : public Search_Method {
+// Heuristic calls are statically dispatched to the policy, instantiated in A_Star.cpp
+template <typename Heuristic_Policy>
+class A_Star_Search : public Search_Method {
 public:
-	A_Star(const Environment& environment, size_t depth_limit);
+	A_Star_Search(const Environment& environment, size_t depth_limit);
 	std::vector<Joint_Action> search_joint(const State& state, Recipe recipe, 
 		const Agent_Combination& agents, Agent_Id handoff_agent,
 		const std::vector<Joint_Action>& input_actions, 
 		const Agent_Combination& free_agents, const Action& initial_action = {}) override;
 	std::pair<size_t, Direction> get_dist_direction(Coordinate source, Coordinate dest, size_t walls) override;
+	size_t estimate_length(const State& state, Recipe recipe, const Agent_Combination& agents,
+		Agent_Id handoff_agent) override;
+	std::map<Recipe, std::vector<Joint_Action>> search_joint_multi(const State& state,
+		const std::vector<Recipe>& recipes, const Agent_Combination& agents, Agent_Id handoff_agent) override;
 private:
 	
 	
@@ -236,11 +282,20 @@ private:
 	Search_Info					initialize_variables(Recipe& recipe, const State& original_state, 
 									const Agent_Id& handoff_agent, const Agent_Combination& agents, const std::vector<Joint_Action>& input_actions) const;
 	bool						is_invalid_goal(const Search_Info& si, const Node* node, const Joint_Action& action) const;
+	bool						is_reservation_conflict(const Node* current_node, const Joint_Action& action,
+									const Reservation_Table& reservations) const;
 	bool						is_valid_goal(const Search_Info& si, const Node* node, const Joint_Action& action) const;
 	void						print_current(const Node* node) const;
 	void						print_goal(const Node* node) const;
+	void						print_heuristic_stats() const;
 	bool						process_node(Search_Info& si, Node* node, const Joint_Action& action) const;
+	bool						replace_visited(Search_Info& si, Node* node, Node_Set::iterator visited_it) const;
 
 	Heuristic dist_heuristic; 
-	Heuristic heuristic;
-};
\ No newline at end of file
+	Heuristic_Policy heuristic;
+	std::deque<Heuristic_Policy> target_heuristics;	// One per recipe of search_joint_multi, kept between searches
+};
+
+using A_Star = A_Star_Search<Heuristic>;
+using A_Star_Manhattan = A_Star_Search<Manhattan_Heuristic>;
+using A_Star_Goal_Count = A_Star_Search<Goal_Count_Heuristic>;
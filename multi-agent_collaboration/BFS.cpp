@@ -1,62 +1,412 @@
 #include "BFS.hpp"
 #include "Search.hpp"
+#include "Reservation_Table.hpp"
 
-#include <deque>
-#include <unordered_set>
+#include <algorithm>
 #include <stdexcept>
 
+constexpr uint32_t SIGNATURE_SEPARATOR = UINT32_MAX;
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+constexpr size_t VISITED_INITIAL_SIZE = 1024;
+
+/**
+The search is performed one layer (g) at a time. A state reached again within the layer it was first found in
+keeps the parent with the fewest agent actions, and with the earliest pass time if both have passed. States
+from earlier layers are never revisited. Goals are collected until the layer is done and the best is returned.
+*/
 std::vector<Joint_Action> BFS::search_joint(const State& state,
 	Recipe recipe, const Agent_Combination& agents, Agent_Id handoff_agent,
 	const std::vector<Joint_Action>& input_actions, const Agent_Combination& free_agents, const Action& initial_action) {
 
-	if (handoff_agent.is_not_empty()) {
-		throw std::runtime_error("Handoff agent not supported for bfs");
+	initialize(state, recipe.result);
+	Reservation_Table reservations(environment, state, input_actions, free_agents);
+	auto actions = environment.get_joint_actions(agents);
+
+	for (size_t agent = 0; agent < state.agents.size(); ++agent) {
+		current_cells.at(agent) = convert(state.agents.at(agent).coordinate);
 	}
+	auto configuration = get_configuration(state);
+	nodes.push_back({ get_key(configuration, current_cells, false), configuration, NO_NODE, NO_NODE, 0, EMPTY_VAL });
+	visited.insert(nodes.back().key, 0);
 
-	if (initial_action.has_value()) {
-		throw std::runtime_error("Initial action not supported for bfs");
+	// Immediate handoff
+	if (handoff_agent.is_not_empty() && can_pass(nodes.back(), handoff_agent, recipe)) {
+		auto pass_node = nodes.back();
+		pass_node.key |= 1;
+		pass_node.pass_time = 0;
+		add_node(pass_node, 0);
 	}
 
-	Search_Joint_State dummy(state, { }, 0, 0);
-	std::unordered_set<Search_Joint_State> visited;
-	std::vector<Search_Joint_State> path;
-	std::deque<Search_Joint_State> frontier;
-	path.push_back(dummy);
-	visited.insert(dummy);
-	frontier.push_back(dummy);
-	bool done = false;
-	size_t state_id = 1;
-	size_t goal_id = 0;
+	Node goal{ 0, 0, NO_NODE, NO_NODE, EMPTY_VAL, EMPTY_VAL };
+	size_t layer_begin = 0;
+	for (size_t g = 0; g < depth_limit; ++g) {
+		size_t layer_end = nodes.size();
 
-	auto actions = environment.get_joint_actions(agents);
-	while (!done) {
 		// No possible path
-		if (frontier.empty()) {
+		if (layer_begin == layer_end) {
 			return {};
 		}
-		auto current_state = frontier.front();
-		frontier.pop_front();
-
-		for (const auto& action : actions) {
-			auto temp_state = current_state;
-			environment.act(temp_state.state, action, Print_Level::NOPE);
-			auto search_state = Search_Joint_State(temp_state.state, action, current_state.id, state_id);
-			if (visited.find(search_state) == visited.end()) {
-				visited.insert(search_state);
-				path.push_back(search_state);
-				frontier.push_back(search_state);
-				if (temp_state.state.contains_item(recipe.result)) {
-					done = true;
-					goal_id = state_id;
-					break;
+
+		for (size_t index = layer_begin; index < layer_end; ++index) {
+			if (is_deadline_passed()) {
+				return {};
+			}
+			auto node = nodes.at(index);
+			bool has_passed = node.pass_time != EMPTY_VAL;
+			get_cells(node.key, current_cells);
+
+			for (uint32_t action_index = 0; action_index < actions.size(); ++action_index) {
+				const auto& action = actions.at(action_index);
+				if (!is_action_allowed(node, g, action, handoff_agent, input_actions, free_agents, initial_action, reservations)) {
+					continue;
+				}
+
+				uint32_t next_configuration;
+				if (!perform(node.configuration, action, next_configuration)) {
+					continue;
+				}
+
+				Node next_node{ get_key(next_configuration, next_cells, has_passed), next_configuration,
+					static_cast<uint32_t>(index), action_index, node.action_count + get_action_cost(action, handoff_agent),
+					node.pass_time };
+
+				if (has_result.at(next_configuration)) {
+
+					// Goal state which does NOT satisfy handoff_agent
+					if (handoff_agent.is_not_empty() && action.is_not_none(handoff_agent)) {
+						continue;
+					}
+
+					// Goal state which DOES satisfy handoff_agent
+					if (!handoff_agent.is_not_empty() || has_passed) {
+						if (is_better(goal, next_node.action_count, next_node.pass_time)) {
+							goal = next_node;
+						}
+						continue;
+					}
+				}
+				add_node(next_node, layer_end);
+			}
+		}
+
+		// Handoff agent passes in the states of the new layer, after their parents are final
+		if (handoff_agent.is_not_empty()) {
+			size_t next_layer_end = nodes.size();
+			for (size_t index = layer_end; index < next_layer_end; ++index) {
+				auto pass_node = nodes.at(index);
+				if (pass_node.pass_time != EMPTY_VAL || !can_pass(pass_node, handoff_agent, recipe)) {
+					continue;
+				}
+				pass_node.key |= 1;
+				pass_node.pass_time = g + 1;
+				if (has_result.at(pass_node.configuration)) {
+					if (is_better(goal, pass_node.action_count, pass_node.pass_time)) {
+						goal = pass_node;
+					}
+					continue;
 				}
-				++state_id;
+				add_node(pass_node, layer_end);
 			}
 		}
+
+		if (goal.parent != NO_NODE) {
+			return extract_actions(goal, actions);
+		}
+		layer_begin = layer_end;
 	}
-	return extract_actions<Search_Joint_State>(goal_id, path);
+	return {};
 }
 
 std::pair<size_t, Direction> BFS::get_dist_direction(Coordinate source, Coordinate dest, size_t walls) {
 	throw std::runtime_error("Not implemented");
 }
+
+// No distance tables, goals must be searched
+size_t BFS::estimate_length(const State& state, Recipe recipe, const Agent_Combination& agents, Agent_Id handoff_agent) {
+	return EMPTY_VAL;
+}
+
+void BFS::initialize(const State& state, Ingredient result) {
+	if (walls.empty()) {
+		width = environment.get_width();
+		height = environment.get_height();
+		cells = width * height;
+		walls.resize(cells);
+		for (size_t x = 0; x < width; ++x) {
+			for (size_t y = 0; y < height; ++y) {
+				walls.at(convert({ x, y })) = environment.is_cell_type({ x, y }, Cell_Type::WALL);
+			}
+		}
+	}
+
+	position_space = 1;
+	for (size_t agent = 0; agent < state.agents.size(); ++agent) {
+		if (position_space > UINT32_MAX / cells) {
+			throw std::runtime_error("Too many agents for bfs");
+		}
+		position_space *= cells;
+	}
+	current_cells.resize(state.agents.size());
+	next_cells.resize(state.agents.size());
+
+	this->result = result;
+	configurations.clear();
+	has_result.clear();
+	signatures.clear();
+	signature_offsets.assign(1, 0);
+	configuration_lookup.clear();
+	nodes.clear();
+	visited.clear();
+}
+
+// Interns the items, goal items and held items of the state
+uint32_t BFS::get_configuration(const State& state) {
+	signature.clear();
+	for (const auto& [coordinate, ingredient] : state.items) {
+		signature.push_back(static_cast<uint32_t>(convert(coordinate)));
+		signature.push_back(static_cast<uint32_t>(ingredient));
+	}
+	signature.push_back(SIGNATURE_SEPARATOR);
+	for (const auto& [coordinate, ingredient] : state.goal_items) {
+		signature.push_back(static_cast<uint32_t>(convert(coordinate)));
+		signature.push_back(static_cast<uint32_t>(ingredient));
+	}
+	signature.push_back(SIGNATURE_SEPARATOR);
+	for (const auto& agent : state.agents) {
+		signature.push_back(agent.item.has_value() ? static_cast<uint32_t>(agent.item.value()) : 0);
+	}
+
+	uint64_t hash = FNV_OFFSET;
+	for (const auto& value : signature) {
+		hash = (hash ^ value) * FNV_PRIME;
+	}
+
+	auto [begin, end] = configuration_lookup.equal_range(hash);
+	for (auto it = begin; it != end; ++it) {
+		auto offset = signature_offsets.at(it->second);
+		auto size = signature_offsets.at(it->second + 1) - offset;
+		if (size == signature.size() && std::equal(signature.begin(), signature.end(), signatures.begin() + offset)) {
+			return it->second;
+		}
+	}
+
+	auto configuration = static_cast<uint32_t>(configurations.size());
+	if (configuration >= (UINT64_MAX >> 1) / position_space) {
+		throw std::runtime_error("Too many item configurations for bfs");
+	}
+	configurations.push_back(state);
+	has_result.push_back(state.contains_item(result));
+	signatures.insert(signatures.end(), signature.begin(), signature.end());
+	signature_offsets.push_back(signatures.size());
+	configuration_lookup.emplace(hash, configuration);
+	return configuration;
+}
+
+uint64_t BFS::get_key(uint32_t configuration, const std::vector<size_t>& agent_cells, bool has_passed) const {
+	uint64_t positions = 0;
+	for (auto it = agent_cells.rbegin(); it != agent_cells.rend(); ++it) {
+		positions = positions * cells + *it;
+	}
+	return ((configuration * position_space + positions) << 1) | (has_passed ? 1 : 0);
+}
+
+void BFS::get_cells(uint64_t key, std::vector<size_t>& agent_cells) const {
+	uint64_t positions = (key >> 1) % position_space;
+	for (auto& cell : agent_cells) {
+		cell = positions % cells;
+		positions /= cells;
+	}
+}
+
+size_t BFS::convert(const Coordinate& coordinate) const {
+	return coordinate.first * height + coordinate.second;
+}
+
+Coordinate BFS::to_coordinate(size_t cell) const {
+	return { cell / height, cell % height };
+}
+
+// Performs the action from current_cells into next_cells
+bool BFS::perform(uint32_t configuration, const Joint_Action& action, uint32_t& next_configuration) {
+
+	// Moves between floor cells only need the collision check of Environment::act
+	bool is_move = true;
+	for (size_t agent = 0; agent < current_cells.size() && is_move; ++agent) {
+		auto direction = action.actions.at(agent).direction;
+		if (direction == Direction::NONE) {
+			next_cells.at(agent) = current_cells.at(agent);
+			continue;
+		}
+		auto coordinate = environment.move_noclip(to_coordinate(current_cells.at(agent)), direction);
+		is_move = coordinate.first < width && coordinate.second < height && !walls.at(convert(coordinate));
+		if (is_move) {
+			next_cells.at(agent) = convert(coordinate);
+		}
+	}
+	if (is_move) {
+		for (size_t agent1 = 0; agent1 < current_cells.size(); ++agent1) {
+			for (size_t agent2 = agent1 + 1; agent2 < current_cells.size(); ++agent2) {
+				if (next_cells.at(agent1) == next_cells.at(agent2)
+					|| current_cells.at(agent1) == next_cells.at(agent2)
+					|| current_cells.at(agent2) == next_cells.at(agent1)) {
+					return false;
+				}
+			}
+		}
+		next_configuration = configuration;
+		return true;
+	}
+
+	// Interactions
+	scratch_state = configurations.at(configuration);
+	for (size_t agent = 0; agent < current_cells.size(); ++agent) {
+		scratch_state.agents.at(agent).coordinate = to_coordinate(current_cells.at(agent));
+	}
+	if (!environment.act(scratch_state, action, Print_Level::NOPE)) {
+		return false;
+	}
+	next_configuration = get_configuration(scratch_state);
+	for (size_t agent = 0; agent < current_cells.size(); ++agent) {
+		next_cells.at(agent) = convert(scratch_state.agents.at(agent).coordinate);
+	}
+	return true;
+}
+
+// Same restrictions as A_Star, the input actions are checked against current_cells
+bool BFS::is_action_allowed(const Node& node, size_t g, const Joint_Action& action, Agent_Id handoff_agent,
+	const std::vector<Joint_Action>& input_actions, const Agent_Combination& free_agents,
+	const Action& initial_action, const Reservation_Table& reservations) const {
+
+	if (g == 0
+		&& initial_action.has_value()
+		&& action.get_action(initial_action.agent) != initial_action) {
+		return false;
+	}
+
+	if (g < input_actions.size()) {
+		for (const auto& input_action : input_actions.at(g).actions) {
+			if (!free_agents.contains(input_action.agent)
+				&& input_action != action.get_action(input_action.agent)) {
+				return false;
+			}
+		}
+	}
+
+	// Useful action from handoff agent after handoff
+	if (node.pass_time != EMPTY_VAL
+		&& handoff_agent.is_not_empty()
+		&& action.is_not_none(handoff_agent)) {
+		return false;
+	}
+
+	if (g < reservations.get_length()) {
+		for (const auto& single_action : action.actions) {
+			if (reservations.is_reserved(single_action.agent)) {
+				continue;
+			}
+			auto current = to_coordinate(current_cells.at(single_action.agent.id));
+			if (reservations.is_conflict(current, environment.move(current, single_action.direction), g)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool BFS::can_pass(const Node& node, Agent_Id handoff_agent, Recipe recipe) const {
+	const auto& item = configurations.at(node.configuration).agents.at(handoff_agent.id).item;
+	return !item.has_value()
+		|| (item.value() != recipe.ingredient1
+			&& item.value() != recipe.ingredient2);
+}
+
+// Whether the counts are better than those of the node, for the same state in the same layer
+bool BFS::is_better(const Node& node, size_t action_count, size_t pass_time) const {
+	if (action_count != node.action_count) {
+		return action_count < node.action_count;
+	}
+	return pass_time != EMPTY_VAL && node.pass_time != EMPTY_VAL && pass_time < node.pass_time;
+}
+
+// Adds the node, or replaces the same state if first found in the layer and worse
+void BFS::add_node(const Node& node, size_t layer_begin) {
+	auto index = visited.find(node.key);
+	if (index == NO_NODE) {
+		visited.insert(node.key, static_cast<uint32_t>(nodes.size()));
+		nodes.push_back(node);
+	}
+	else if (index >= layer_begin && is_better(nodes.at(index), node.action_count, node.pass_time)) {
+		nodes.at(index) = node;
+	}
+}
+
+size_t BFS::get_action_cost(const Joint_Action& joint_action, Agent_Id handoff_agent) const {
+	size_t result = 0;
+	for (size_t agent = 0; agent < joint_action.size(); ++agent) {
+		if (!handoff_agent.is_not_empty() || handoff_agent.id != agent) {
+			result += joint_action.get_action(agent).is_none() ? 0 : 1;
+		}
+	}
+	return result;
+}
+
+std::vector<Joint_Action> BFS::extract_actions(const Node& goal, const std::vector<Joint_Action>& actions) const {
+	std::vector<Joint_Action> result;
+	for (const Node* node = &goal; node->parent != NO_NODE; node = &nodes.at(node->parent)) {
+		result.push_back(actions.at(node->action));
+	}
+	std::reverse(result.begin(), result.end());
+	return result;
+}
+
+void BFS::Visited_Table::clear() {
+	if (keys.empty()) {
+		keys.resize(VISITED_INITIAL_SIZE);
+		nodes.resize(VISITED_INITIAL_SIZE);
+	}
+	std::fill(keys.begin(), keys.end(), EMPTY_KEY);
+	count = 0;
+}
+
+uint32_t BFS::Visited_Table::find(uint64_t key) const {
+	for (size_t slot = get_slot(key); ; slot = (slot + 1) & (keys.size() - 1)) {
+		if (keys[slot] == key) {
+			return nodes[slot];
+		}
+		if (keys[slot] == EMPTY_KEY) {
+			return NO_NODE;
+		}
+	}
+}
+
+void BFS::Visited_Table::insert(uint64_t key, uint32_t node) {
+	if ((count + 1) * 2 > keys.size()) {
+		grow();
+	}
+	auto slot = get_slot(key);
+	while (keys[slot] != EMPTY_KEY) {
+		slot = (slot + 1) & (keys.size() - 1);
+	}
+	keys[slot] = key;
+	nodes[slot] = node;
+	++count;
+}
+
+size_t BFS::Visited_Table::get_slot(uint64_t key) const {
+	key *= 0x9E3779B97F4A7C15ull;
+	return static_cast<size_t>(key ^ (key >> 32)) & (keys.size() - 1);
+}
+
+void BFS::Visited_Table::grow() {
+	auto old_keys = std::move(keys);
+	auto old_nodes = std::move(nodes);
+	keys.assign(old_keys.size() * 2, EMPTY_KEY);
+	nodes.assign(old_nodes.size() * 2, NO_NODE);
+	count = 0;
+	for (size_t slot = 0; slot < old_keys.size(); ++slot) {
+		if (old_keys[slot] != EMPTY_KEY) {
+			insert(old_keys[slot], old_nodes[slot]);
+		}
+	}
+}
@@ -1,17 +1,94 @@
 #pragma once
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 #include "Environment.hpp"
 #include "Search.hpp"
 
+class Reservation_Table;
 
-
+// Breadth first search over compact state ids, with the handoff and input action semantics of A_Star.
+// Results are shortest in joint actions, then in agent actions (action count as in A_Star). A state id packs
+// the agent cells, whether the handoff agent has passed, and the id of the item configuration (items, goal
+// items and held items) which is stored once with a representative State. Joint actions which only move
+// agents between floor cells are resolved on the cells, others are performed on a copy of the representative.
+// Buffers are kept between searches, so searches of similar size do not allocate per state.
 class BFS : public Search_Method {
 public:
 	using Search_Method::Search_Method;
-	std::vector<Joint_Action> search_joint(const State& state, 
-		Recipe recipe, const Agent_Combination& agents, 
+	std::vector<Joint_Action> search_joint(const State& state,
+		Recipe recipe, const Agent_Combination& agents,
 		Agent_Id handoff_agent,
-		const std::vector<Joint_Action>& input_actions, 
+		const std::vector<Joint_Action>& input_actions,
 		const Agent_Combination& free_agents, const Action& initial_action) override;
 	std::pair<size_t, Direction> get_dist_direction(Coordinate source, Coordinate dest, size_t walls) override;
-};
\ No newline at end of file
+	size_t estimate_length(const State& state, Recipe recipe, const Agent_Combination& agents,
+		Agent_Id handoff_agent) override;
+
+private:
+	static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+	struct Node {
+		uint64_t key;
+		uint32_t configuration;
+		uint32_t parent;
+		uint32_t action;			// Index into the joint actions of the agents
+		size_t action_count;
+		size_t pass_time;
+	};
+
+	// Open addressing from state id to node index
+	class Visited_Table {
+	public:
+		void		clear();
+		uint32_t	find(uint64_t key) const;
+		void		insert(uint64_t key, uint32_t node);
+	private:
+		static constexpr uint64_t EMPTY_KEY = UINT64_MAX;
+		size_t	get_slot(uint64_t key) const;
+		void	grow();
+
+		std::vector<uint64_t> keys;
+		std::vector<uint32_t> nodes;
+		size_t count = 0;
+	};
+
+	void		initialize(const State& state, Ingredient result);
+	uint32_t	get_configuration(const State& state);
+	uint64_t	get_key(uint32_t configuration, const std::vector<size_t>& agent_cells, bool has_passed) const;
+	void		get_cells(uint64_t key, std::vector<size_t>& agent_cells) const;
+	size_t		convert(const Coordinate& coordinate) const;
+	Coordinate	to_coordinate(size_t cell) const;
+	bool		perform(uint32_t configuration, const Joint_Action& action, uint32_t& next_configuration);
+	bool		is_action_allowed(const Node& node, size_t g, const Joint_Action& action, Agent_Id handoff_agent,
+					const std::vector<Joint_Action>& input_actions, const Agent_Combination& free_agents,
+					const Action& initial_action, const Reservation_Table& reservations) const;
+	bool		can_pass(const Node& node, Agent_Id handoff_agent, Recipe recipe) const;
+	bool		is_better(const Node& node, size_t action_count, size_t pass_time) const;
+	void		add_node(const Node& node, size_t layer_begin);
+	size_t		get_action_cost(const Joint_Action& action, Agent_Id handoff_agent) const;
+	std::vector<Joint_Action> extract_actions(const Node& goal, const std::vector<Joint_Action>& actions) const;
+
+	size_t width = 0;
+	size_t height = 0;
+	size_t cells = 0;
+	uint64_t position_space = 0;	// Cells to the power of agents
+	std::vector<bool> walls;
+
+	// Item configurations of the current search
+	Ingredient result = Ingredient::DELIVERY;
+	std::vector<State> configurations;
+	std::vector<bool> has_result;
+	std::vector<uint32_t> signatures;
+	std::vector<size_t> signature_offsets;
+	std::unordered_multimap<uint64_t, uint32_t> configuration_lookup;
+
+	std::vector<Node> nodes;
+	Visited_Table visited;
+
+	// Scratch
+	State scratch_state;
+	std::vector<uint32_t> signature;
+	std::vector<size_t> current_cells;
+	std::vector<size_t> next_cells;
+};
@@ -59,20 +59,20 @@ bool Ingredients::have_ingredients(const Recipe& recipe, const Environment& envi
 bool Environment::is_inbounds(const Coordinate& coordinate) const {
 	return coordinate.first >= 0
 		&& coordinate.second >= 0
-		&& coordinate.first < width
-		&& coordinate.second < height;
+		&& coordinate.first < level->width
+		&& coordinate.second < level->height;
 }
 
 bool Environment::is_cell_type(const Coordinate& coordinate, const Cell_Type& type) const {
 	switch (type) {
 		case Cell_Type::WALL: {
-			return walls.at(coordinate.first).at(coordinate.second);
+			return level->walls.at(coordinate.first).at(coordinate.second);
 		}
 		case Cell_Type::CUTTING_STATION: {
-			return std::find(cutting_stations.begin(), cutting_stations.end(), coordinate) != cutting_stations.end();
+			return std::find(level->cutting_stations.begin(), level->cutting_stations.end(), coordinate) != level->cutting_stations.end();
 		}
 		case Cell_Type::DELIVERY_STATION: {
-			return std::find(delivery_stations.begin(), delivery_stations.end(), coordinate) != delivery_stations.end();
+			return std::find(level->delivery_stations.begin(), level->delivery_stations.end(), coordinate) != level->delivery_stations.end();
 		}
 	}
 	std::cout << "ERROR: Exiting MAC due to invalid cell type.";
@@ -304,7 +304,7 @@ std::vector<Joint_Action> Environment::get_joint_actions(const Agent_Combination
 }
 
 State Environment::load(const std::string& path) {
-	reset();
+	auto new_level = std::make_shared<Level>();
 	std::ifstream file;
 	file.open(path);
 	std::string line;
@@ -320,12 +320,12 @@ State Environment::load(const std::string& path) {
 	size_t line_counter = 0;
 	while (std::getline(file, line)) {
 		if (line_counter == 0) {
-			width = line.size();
+			new_level->width = line.size();
 		}
 
 		if (line.empty()) {
 			if (load_status == 0) {
-				height = line_counter;
+				new_level->height = line_counter;
 			}
 			++load_status;
 			continue;
@@ -334,18 +334,18 @@ State Environment::load(const std::string& path) {
 		// Level file as defined by BD paper is split in 3 sections
 		switch (load_status) {
 		case 0: {
-			load_map_line(state, line_counter, line, width);
+			new_level->load_map_line(state, line_counter, line, new_level->width);
 			break;
 		}
 		case 1: {
-			goal_names.push_back(line);
-			goal_ingredients.add_ingredient(goal_name_to_ingredient(line));
+			new_level->goal_names.push_back(line);
+			new_level->goal_ingredients.add_ingredient(goal_name_to_ingredient(line));
 			break;
 		}
 		case 2: {
 			int x = atoi(&line[0]);
 			int y = atoi(&line[2]);
-			agents_initial_positions.push_back({ x, y });
+			new_level->agents_initial_positions.push_back({ x, y });
 			break;
 		}
 		}
@@ -356,17 +356,18 @@ State Environment::load(const std::string& path) {
 	}
 
 	for (size_t agent = 0; agent < number_of_agents; ++agent) {
-		state.agents.push_back(agents_initial_positions.at(agent));
+		state.agents.push_back(new_level->agents_initial_positions.at(agent));
 	}
 
-	calculate_recipes();
+	new_level->calculate_recipes();
+	new_level->flip_walls_array();
+	level = new_level;
 
-	flip_walls_array();
 	file.close();
 	return state;
 }
 
-void Environment::load_map_line(State& state, size_t& line_counter, const std::string& line, size_t width) {
+void Level::load_map_line(State& state, size_t& line_counter, const std::string& line, size_t width) {
 
 	std::vector<bool> wall_line;
 	wall_line.reserve(width);
@@ -395,7 +396,7 @@ void Environment::load_map_line(State& state, size_t& line_counter, const std::s
 	walls.push_back(wall_line);
 }
 
-void Environment::flip_walls_array() {
+void Level::flip_walls_array() {
 
 	// Flips walls array so the first coordinate is x, not y
 	auto walls_copy = walls;
@@ -412,8 +413,8 @@ void Environment::print_state() const {
 }
 void Environment::print_state(const State& state) const {
 	std::string buffer;
-	for (size_t y = 0; y < walls.size(); ++y) {
-		for (size_t x = 0; x < walls.at(0).size(); ++x) {
+	for (size_t y = 0; y < level->walls.size(); ++y) {
+		for (size_t x = 0; x < level->walls.at(0).size(); ++x) {
 			auto agent_it = std::find_if(state.agents.begin(), state.agents.end(), [x, y](Agent agent)->bool {return agent.coordinate == Coordinate{ x, y }; });
 
 			if (state.items.find({ x, y }) != state.items.end()) {
@@ -431,15 +432,15 @@ void Environment::print_state(const State& state) const {
 				}
 
 			}
-			else if (std::find(cutting_stations.begin(), cutting_stations.end(), Coordinate{ x, y }) != cutting_stations.end()) {
+			else if (std::find(level->cutting_stations.begin(), level->cutting_stations.end(), Coordinate{ x, y }) != level->cutting_stations.end()) {
 				buffer += static_cast<char>(Cell_Type::CUTTING_STATION);
 
 			}
-			else if (std::find(delivery_stations.begin(), delivery_stations.end(), Coordinate{ x, y }) != delivery_stations.end()) {
+			else if (std::find(level->delivery_stations.begin(), level->delivery_stations.end(), Coordinate{ x, y }) != level->delivery_stations.end()) {
 				buffer += static_cast<char>(Cell_Type::DELIVERY_STATION);
 
 			}
-			else if (walls.at(x).at(y)) {
+			else if (level->walls.at(x).at(y)) {
 				buffer += static_cast<char>(Cell_Type::WALL);
 
 			}
@@ -509,7 +510,7 @@ Ingredient Environment::goal_name_to_ingredient(const std::string& name) const {
     throw std::invalid_argument("Unknown goal ingredient: " + name);
 }
 
-void Environment::load_recipes() {
+void Level::load_recipes() {
 	static const std::map<std::pair<Ingredient, Ingredient>, Ingredient> recipes_raw = {
 	{ {Ingredient::CUTTING, Ingredient::TOMATO}, Ingredient::CHOPPED_TOMATO},
 	{ {Ingredient::CUTTING, Ingredient::LETTUCE}, Ingredient::CHOPPED_LETTUCE},
@@ -536,8 +537,8 @@ void Environment::load_recipes() {
 
 // Not a great way to define recipes, but functional for now
 std::optional<Ingredient> Environment::get_recipe(Ingredient ingredient1, Ingredient ingredient2) const {
-	auto recipe_it = recipes_map.find({ ingredient1, ingredient2 });
-	if (recipe_it != recipes_map.end()) {
+	auto recipe_it = level->recipes_map.find({ ingredient1, ingredient2 });
+	if (recipe_it != level->recipes_map.end()) {
 		return recipe_it->second;
 	}
 	else {
@@ -550,7 +551,7 @@ std::vector<Recipe> Environment::get_possible_recipes(const State& state) const
 	std::vector<Recipe> possible_recipes;
 	auto ingredients_count_in = state.get_ingredients_count();
 
-	for (const auto& recipe : goal_related_recipes) {
+	for (const auto& recipe : level->goal_related_recipes) {
 
 		if ((state.contains_item(recipe.ingredient1)
 			|| recipe.ingredient1 == Ingredient::CUTTING
@@ -581,11 +582,11 @@ bool Environment::does_recipe_lead_to_goal(const Ingredients& ingredients_count_
 bool Environment::do_ingredients_lead_to_goal(const Ingredients& ingredients) const {
 
 	// Check goal condition
-	if (goal_ingredients <= ingredients) {
+	if (level->goal_ingredients <= ingredients) {
 		return true;
 	}
 
-	for (const auto& recipe : all_recipes) {
+	for (const auto& recipe : level->all_recipes) {
 		Ingredients recipe_ingredients;
 		recipe_ingredients.add_ingredients(recipe, *this);
 		if (recipe_ingredients > ingredients) {
@@ -599,12 +600,12 @@ bool Environment::do_ingredients_lead_to_goal(const Ingredients& ingredients) co
 }
 
 const std::vector<Recipe>& Environment::get_all_recipes() const {
-	return goal_related_recipes;
+	return level->goal_related_recipes;
 }
 
 bool Environment::is_done(const State& state) const {
 	auto state_ingredients = state.get_ingredients_count();
-	return goal_ingredients <= state_ingredients;
+	return level->goal_ingredients <= state_ingredients;
 }
 
 Coordinate Environment::move(const Coordinate& coordinate, Direction direction) const {
@@ -616,7 +617,7 @@ Coordinate Environment::move(const Coordinate& coordinate, Direction direction)
 	case Direction::LEFT:	new_coordinate = { coordinate.first - 1, coordinate.second }; break;
 	default: return coordinate;
 	}
-	if (walls.at(new_coordinate.first).at(new_coordinate.second)) {
+	if (level->walls.at(new_coordinate.first).at(new_coordinate.second)) {
 		return coordinate;
 	}
 	else {
@@ -655,11 +656,11 @@ std::vector<Location> Environment::get_locations(const State& state, Ingredient
 	std::vector<Location> result;
 	switch (ingredient) {
 	case Ingredient::CUTTING: {
-		for (auto& coord : cutting_stations) result.push_back({ coord, coord, false });
+		for (auto& coord : level->cutting_stations) result.push_back({ coord, coord, false });
 		return result;
 	}
 	case Ingredient::DELIVERY: {
-		for (auto& coord : delivery_stations) result.push_back({ coord, coord, false });
+		for (auto& coord : level->delivery_stations) result.push_back({ coord, coord, false });
 		return result;
 	}
 	default: return state.get_locations(ingredient);
@@ -674,8 +675,8 @@ std::vector<Location> Environment::get_non_wall_locations(const State& state, In
 
 std::vector<Coordinate> Environment::get_coordinates(const State& state, Ingredient ingredient, bool include_agent_holding) const {
 	switch (ingredient) {
-	case Ingredient::CUTTING: return cutting_stations;
-	case Ingredient::DELIVERY: return delivery_stations;
+	case Ingredient::CUTTING: return level->cutting_stations;
+	case Ingredient::DELIVERY: return level->delivery_stations;
 	default: return state.get_coordinates(ingredient, include_agent_holding);
 	}
 }
@@ -684,19 +685,7 @@ std::vector<Coordinate> Environment::get_recipe_locations(const State& state, In
 	throw std::runtime_error("");
 }
 
-void Environment::reset() {
-	goal_names.clear();
-	goal_ingredients.clear();
-	agents_initial_positions.clear();
-
-	walls.clear();
-	cutting_stations.clear();
-	delivery_stations.clear();
-	goal_related_recipes.clear();
-}
-
-
-void Environment::calculate_recipes() {
+void Level::calculate_recipes() {
 
 	std::set<Ingredient> ingredients = goal_ingredients.get_types();
 	auto ingredients_size = EMPTY_VAL;
@@ -722,10 +711,10 @@ void Environment::calculate_recipes() {
 
 
 size_t Environment::get_width() const {
-	return width;
+	return level->width;
 }
 size_t Environment::get_height() const {
-	return height;
+	return level->height;
 }
 
 std::vector<Coordinate> Environment::get_neighbours(Coordinate location) const {
@@ -4,6 +4,7 @@
 
 #include <vector>
 #include <map>
+#include <memory>
 #include <utility>
 #include <string>
 #include <optional>
@@ -448,15 +449,39 @@ struct Agent {
 };
 
 
+// Static data of a loaded level. Built once per load and shared read-only by all copies of the
+// environment held by planners, searchers and heuristics.
+struct Level {
+	Level() : width(), height(), agents_initial_positions(), all_recipes(), cutting_stations(),
+		delivery_stations(), goal_ingredients(), goal_names(), goal_related_recipes(), recipes_map(), walls() {
+		load_recipes();
+	}
+
+	void calculate_recipes();
+	void flip_walls_array();
+	void load_map_line(State& state, size_t& line_counter, const std::string& line, size_t width);
+	void load_recipes();
+
+	size_t width;
+	size_t height;
+
+	std::vector<Coordinate>										agents_initial_positions;
+	std::vector<Recipe>											all_recipes;
+	std::vector<Coordinate>										cutting_stations;
+	std::vector<Coordinate>										delivery_stations;
+	Ingredients													goal_ingredients;
+	std::vector<std::string>									goal_names;
+	std::vector<Recipe>											goal_related_recipes;
+	std::map<std::pair<Ingredient, Ingredient>, Ingredient>		recipes_map;
+	std::vector<std::vector<bool>>								walls;
+};
+
 class Environment {
 
 public:
 
 	Environment(size_t number_of_agents) :
-		number_of_agents(number_of_agents), goal_names(), agents_initial_positions(), walls(), 
-		cutting_stations(), delivery_stations(), width(), height() {
-		load_recipes();
-	};
+		number_of_agents(number_of_agents), level(std::make_shared<const Level>()) {};
 
 	bool			act(State& state, const Action& action) const;
 	bool			act(State& state, const Action& action, Print_Level print_level) const;
@@ -492,28 +517,12 @@ public:
 	size_t						get_width() const;
 	
 private:
-	void						calculate_recipes();
 	bool						contains_collisions(const State& state, const Joint_Action& joint_action) const;
 	bool						does_recipe_lead_to_goal(const Ingredients& ingredients_count, const Recipe& recipe_in) const;
-	void						flip_walls_array();
 	std::optional<Ingredient>	get_recipe(Ingredient ingredient1, Ingredient ingredient2) const;
 	Ingredient					goal_name_to_ingredient(const std::string& name) const;
-	void						load_map_line(State& state, size_t& line_counter, const std::string& line, size_t width);
-	void						load_recipes();
-	void						reset();
 	
-	size_t width;
-	size_t height;
-	size_t number_of_agents;
-
-	std::vector<Coordinate>										agents_initial_positions;
-	std::vector<Recipe>											all_recipes;
-	std::vector<Coordinate>										cutting_stations;
-	std::vector<Coordinate>										delivery_stations;
-	Ingredients													goal_ingredients;
-	std::vector<std::string>									goal_names;
-	std::vector<Recipe>											goal_related_recipes;
-	std::map<std::pair<Ingredient, Ingredient>, Ingredient>		recipes_map;
-	std::vector<std::vector<bool>>								walls;
+	size_t						number_of_agents;
+	std::shared_ptr<const Level>	level;
 };
 
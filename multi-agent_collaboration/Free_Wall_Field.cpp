@@ -0,0 +1,121 @@
+#include "Free_Wall_Field.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+Free_Wall_Field::Free_Wall_Field(const Environment& environment)
+	: width(environment.get_width()), height(environment.get_height()),
+	walls(width* height, false), occupied(width* height, false), occupied_cells(),
+	next_occupied_cells(), changed_cells(), entries(width* height) {
+
+	for (size_t x = 0; x < width; ++x) {
+		for (size_t y = 0; y < height; ++y) {
+			walls.at(convert({ x, y })) = environment.is_cell_type({ x, y }, Cell_Type::WALL);
+		}
+	}
+	for (size_t x = 0; x < width; ++x) {
+		for (size_t y = 0; y < height; ++y) {
+			calculate({ x, y });
+		}
+	}
+}
+
+void Free_Wall_Field::update(const State& state) {
+
+	// Items are ordered by coordinate, so the occupied cells come out sorted
+	next_occupied_cells.clear();
+	for (const auto& item : state.items) {
+		auto cell = convert(item.first);
+		if (walls.at(cell)) {
+			next_occupied_cells.push_back(cell);
+		}
+	}
+	if (next_occupied_cells == occupied_cells) {
+		return;
+	}
+
+	changed_cells.clear();
+	std::set_symmetric_difference(occupied_cells.begin(), occupied_cells.end(),
+		next_occupied_cells.begin(), next_occupied_cells.end(), std::back_inserter(changed_cells));
+	std::swap(occupied_cells, next_occupied_cells);
+
+	for (const auto& cell : changed_cells) {
+		occupied.at(cell) = !occupied.at(cell);
+	}
+	for (const auto& cell : changed_cells) {
+		calculate_around({ cell / height, cell % height });
+	}
+}
+
+size_t Free_Wall_Field::get_distance(const Coordinate& coordinate, const Coordinate& blocked) const {
+	const auto& entry = entries.at(convert(coordinate));
+	if (entry.nearest_count == 1 && is_free_wall(blocked)) {
+		size_t dx = coordinate.first > blocked.first ? coordinate.first - blocked.first : blocked.first - coordinate.first;
+		size_t dy = coordinate.second > blocked.second ? coordinate.second - blocked.second : blocked.second - coordinate.second;
+		if (dx + dy == entry.nearest) {
+			return entry.second;
+		}
+	}
+	return entry.nearest;
+}
+
+size_t Free_Wall_Field::convert(const Coordinate& coordinate) const {
+	return coordinate.first * height + coordinate.second;
+}
+
+bool Free_Wall_Field::is_free_wall(const Coordinate& coordinate) const {
+	if (coordinate.first >= width || coordinate.second >= height) {
+		return false;
+	}
+	auto cell = convert(coordinate);
+	return walls.at(cell) && !occupied.at(cell);
+}
+
+// Checks rings of increasing distance, like the original nearest wall search
+void Free_Wall_Field::calculate(const Coordinate& coordinate) {
+	Entry entry{ MAX_DISTANCE + 1, 0, MAX_DISTANCE + 1 };
+	for (size_t i = 1; i <= MAX_DISTANCE; ++i) {
+		size_t count = 0;
+		for (size_t j = 0; j <= i; ++j) {
+			size_t a = j;		// Dimension 1 offset
+			size_t b = i - j;	// Dimension 2 offset
+
+			// Unsigned wrap around leaves the grid and is rejected by is_free_wall
+			count += is_free_wall({ coordinate.first + a, coordinate.second + b }) ? 1 : 0;
+			if (b != 0) count += is_free_wall({ coordinate.first + a, coordinate.second - b }) ? 1 : 0;
+			if (a != 0) count += is_free_wall({ coordinate.first - a, coordinate.second + b }) ? 1 : 0;
+			if (a != 0 && b != 0) count += is_free_wall({ coordinate.first - a, coordinate.second - b }) ? 1 : 0;
+		}
+		if (count == 0) {
+			continue;
+		}
+		if (entry.nearest_count == 0) {
+			entry.nearest = static_cast<uint8_t>(i);
+			entry.nearest_count = static_cast<uint8_t>(std::min<size_t>(count, 2));
+			if (count > 1) {
+				break;
+			}
+		}
+		else {
+			entry.second = static_cast<uint8_t>(i);
+			break;
+		}
+	}
+	entries.at(convert(coordinate)) = entry;
+}
+
+void Free_Wall_Field::calculate_around(const Coordinate& coordinate) {
+	auto x_min = coordinate.first >= MAX_DISTANCE ? coordinate.first - MAX_DISTANCE : 0;
+	auto y_min = coordinate.second >= MAX_DISTANCE ? coordinate.second - MAX_DISTANCE : 0;
+	auto x_max = std::min(coordinate.first + MAX_DISTANCE, width - 1);
+	auto y_max = std::min(coordinate.second + MAX_DISTANCE, height - 1);
+	for (size_t x = x_min; x <= x_max; ++x) {
+		for (size_t y = y_min; y <= y_max; ++y) {
+			auto dx = x > coordinate.first ? x - coordinate.first : coordinate.first - x;
+			auto dy = y > coordinate.second ? y - coordinate.second : coordinate.second - y;
+			if (dx + dy <= MAX_DISTANCE) {
+				calculate({ x, y });
+			}
+		}
+	}
+}
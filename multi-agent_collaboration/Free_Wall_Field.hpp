@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Environment.hpp"
+#include "State.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Manhattan distance from each cell to the nearest free wall (wall without an item), searched up to
+// MAX_DISTANCE and MAX_DISTANCE + 1 if none is found. The cell itself is not considered.
+// Built from the static wall layout, update only recomputes the cells around walls whose occupancy
+// changed since the last state. The nearest distance is stored with the amount of walls at that
+// distance and the next distance, so one excluded (blocked) wall can be answered without searching.
+class Free_Wall_Field {
+public:
+	static constexpr size_t MAX_DISTANCE = 3;
+
+	Free_Wall_Field(const Environment& environment);
+	void	update(const State& state);
+	size_t	get_distance(const Coordinate& coordinate, const Coordinate& blocked) const;
+
+private:
+	struct Entry {
+		uint8_t nearest;		// Distance to nearest free wall
+		uint8_t nearest_count;	// Free walls at nearest distance, capped at 2
+		uint8_t second;			// Distance to nearest free wall further away than nearest
+	};
+
+	size_t	convert(const Coordinate& coordinate) const;
+	bool	is_free_wall(const Coordinate& coordinate) const;
+	void	calculate(const Coordinate& coordinate);
+	void	calculate_around(const Coordinate& coordinate);
+
+	size_t width;
+	size_t height;
+	std::vector<bool>	walls;
+	std::vector<bool>	occupied;
+	std::vector<size_t>	occupied_cells;		// Sorted occupied wall cells of the last state
+	std::vector<size_t>	next_occupied_cells;
+	std::vector<size_t>	changed_cells;
+	std::vector<Entry>	entries;
+};
@@ -0,0 +1,63 @@
+#include "Goal_Registry.hpp"
+
+#include <algorithm>
+
+Goal_Registry::Goal_Registry(const Environment& environment)
+	: goals(), coalition_ranks(), recipes(environment.get_all_recipes()),
+	number_of_agents(environment.get_number_of_agents()) {
+
+	recipes.push_back(EMPTY_RECIPE);
+	std::sort(recipes.begin(), recipes.end());
+	recipes.erase(std::unique(recipes.begin(), recipes.end()), recipes.end());
+
+	std::vector<std::pair<Agent_Combination, size_t>> coalitions;
+	size_t mask_count = static_cast<size_t>(1) << number_of_agents;
+	for (size_t mask = 1; mask < mask_count; ++mask) {
+		Agent_Combination agents;
+		for (size_t agent = 0; agent < number_of_agents; ++agent) {
+			if ((mask & (static_cast<size_t>(1) << agent)) != 0) {
+				agents.add(agent);
+			}
+		}
+		coalitions.emplace_back(agents, mask);
+	}
+	std::sort(coalitions.begin(), coalitions.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.first < rhs.first;
+	});
+
+	// Handoff agents are ordered by id, with no handoff agent (EMPTY_VAL) last
+	coalition_ranks.resize(mask_count, EMPTY_VAL);
+	for (size_t rank = 0; rank < coalitions.size(); ++rank) {
+		const auto& [agents, mask] = coalitions.at(rank);
+		coalition_ranks.at(mask) = rank;
+		for (size_t handoff = 0; handoff <= number_of_agents; ++handoff) {
+			Agent_Id handoff_agent = handoff == number_of_agents ? EMPTY_VAL : handoff;
+			for (const auto& recipe : recipes) {
+				goals.emplace_back(agents, recipe, handoff_agent);
+			}
+		}
+	}
+}
+
+size_t Goal_Registry::get_id(const Goal& goal) const {
+	size_t mask = 0;
+	for (const auto& agent : goal.agents) {
+		assert(agent.id < number_of_agents && (mask >> agent.id) == 0);	// Sorted and unique
+		mask |= static_cast<size_t>(1) << agent.id;
+	}
+	auto handoff_rank = goal.handoff_agent.is_empty() ? number_of_agents : goal.handoff_agent.id;
+	auto recipe_rank = static_cast<size_t>(std::lower_bound(recipes.begin(), recipes.end(), goal.recipe) - recipes.begin());
+	assert(recipe_rank < recipes.size() && recipes.at(recipe_rank) == goal.recipe);
+
+	auto id = (coalition_ranks.at(mask) * (number_of_agents + 1) + handoff_rank) * recipes.size() + recipe_rank;
+	assert(goals.at(id) == goal);
+	return id;
+}
+
+const Goal& Goal_Registry::get_goal(size_t id) const {
+	return goals.at(id);
+}
+
+size_t Goal_Registry::size() const {
+	return goals.size();
+}
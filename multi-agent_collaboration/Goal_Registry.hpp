@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Environment.hpp"
+#include "Recogniser.hpp"
+
+#include <vector>
+
+// Dense ids for all goals of an environment, i.e. every coalition, recipe (or none) and handoff agent.
+// Ids follow the Goal order, so containers indexed or sorted by id iterate like maps keyed by Goal.
+// Ids are computed from the coalition mask, handoff agent and recipe rank, without searching.
+class Goal_Registry {
+public:
+	Goal_Registry(const Environment& environment);
+	size_t		get_id(const Goal& goal) const;
+	const Goal&	get_goal(size_t id) const;
+	size_t		size() const;
+
+private:
+	std::vector<Goal>	goals;
+	std::vector<size_t>	coalition_ranks;	// By agent mask, coalitions ordered like Agent_Combination
+	std::vector<Recipe>	recipes;			// Sorted, includes EMPTY_RECIPE
+	size_t				number_of_agents;
+};
@@ -1,15 +1,34 @@
 #include "Heuristic.hpp"
+#include "Heuristic_Cache.hpp"
 #include "Utils.hpp"
 #include "State.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <deque>
+#include <thread>
 #include <cassert>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEURISTIC_SSE2
+#endif
+
+constexpr size_t MAX_CACHE_SIZE = 1 << 16;
+constexpr size_t LAZY_DISTANCES_CELLS = 1024;	// Larger levels search distance rows on first use
+
 struct Location_Info {
 	Coordinate coordinate;
 	size_t wall_penalty;
 };
 
+struct Search_Distance {
+	Search_Distance() : g(EMPTY_VAL), parent(EMPTY_VAL, EMPTY_VAL), wall_g(0) {}
+	size_t g;
+	Coordinate parent;
+	size_t wall_g;
+};
+
 struct Search_Entry {
 	Search_Entry(Coordinate coord, size_t dist, size_t walls, size_t wall_g) 
 		: coord(coord), dist(dist), walls(walls), wall_g(wall_g) {}
@@ -21,54 +40,50 @@ struct Search_Entry {
 
 Heuristic::Heuristic(Environment environment) : environment(environment),
 	ingredient1(Ingredient::DELIVERY), ingredient2(Ingredient::DELIVERY),
-	handoff_agent(), agent_combinations(get_combinations(environment.get_number_of_agents())) {
+	handoff_agent(), agent_combinations(), free_walls(environment), pair_buffers(), pattern_database(), cache(), cache_key(), cache_lookups(0), cache_hits(0) {
 
 	init();
+
+	// Would search every row of a lazy table
+	if (!distances.lazy_rows) {
+		pattern_database = Pattern_Database(environment, distances);
+	}
 }
 
 void Heuristic::set(Ingredient ingredient1, Ingredient ingredient2, const Agent_Combination& agents,
 	const Agent_Id& handoff_agent) {
 
+	// Agents are part of the cache key, so cached values stay valid while the ingredients are unchanged
+	if (this->ingredient1 != ingredient1 || this->ingredient2 != ingredient2) {
+		cache.clear();
+	}
+	cache_lookups = 0;
+	cache_hits = 0;
+
 	this->ingredient1 = ingredient1;
 	this->ingredient2 = ingredient2;
 	this->agent_combinations = get_combinations(agents);
 	this->handoff_agent = handoff_agent;
 }
 
+std::string Heuristic::get_cache_stats() const {
+	return "heuristic cache " + std::to_string(cache_hits) + "/" + std::to_string(cache_lookups) + " hits, "
+		+ std::to_string(cache.size()) + " entries";
+}
+
 std::pair<size_t, Direction> Heuristic::get_dist_direction(Coordinate source, Coordinate dest, size_t walls) const {
-	auto& dist_ref = distances.at(walls).const_at(dest, source);
+	auto dist_ref = distances.const_at(walls, dest, source);
 	std::pair<size_t, Direction> temp{ dist_ref.g, environment.get_direction(source, dist_ref.parent) };
 	std::cout << source.first << ","<< source.second << " to " << dest.first << "," << dest.second << ": dist " << temp.first << ", direction " << static_cast<char>(temp.second) << std::endl;
 	return { dist_ref.g, environment.get_direction(source, dist_ref.parent) };
 }
 
+// Assumes free_walls is updated to the state
 size_t Heuristic::get_distance_to_nearest_wall(Coordinate agent_coord, Coordinate blocked, const State& state) const {
 	if (agent_coord != blocked && environment.is_cell_type(agent_coord, Cell_Type::WALL)) {
 		return 0;
 	}
-	constexpr size_t max_search_dist = 3;
-	for (size_t i = 1; i <= max_search_dist; ++i) {
-		for (size_t j = 0; j <= i; ++j) {
-			size_t a = j;		// Dimension 1 offset
-			size_t b = i - j;	// Dimension 2 offset
-
-			std::vector<Coordinate> coords;
-			coords.emplace_back(agent_coord.first + a, agent_coord.second + b);
-			coords.emplace_back(agent_coord.first + a, agent_coord.second - b);
-			coords.emplace_back(agent_coord.first - a, agent_coord.second + b);
-			coords.emplace_back(agent_coord.first - a, agent_coord.second - b);
-			for (const auto& coord : coords) {
-				if (environment.is_inbounds(coord)
-					&& environment.is_cell_type(coord, Cell_Type::WALL) 
-					&& !state.is_wall_occupied(coord) 
-					&& coord != blocked) {
-					
-					return i;
-				}
-			}
-		}
-	}
-	return max_search_dist + 1;
+	return free_walls.get_distance(agent_coord, blocked);
 }
 
 Helper_Agent_Info Heuristic::find_helper(const std::vector<Helper_Agent_Info>& helpers, const Agent_Id handoff_agent, const Agent_Combination& local_agents, const bool first,
@@ -76,7 +91,6 @@ Helper_Agent_Info Heuristic::find_helper(const std::vector<Helper_Agent_Info>& h
 
 	size_t min_dist = EMPTY_VAL;
 	Agent_Id min_agent = {};
-	const auto& dist_agent_ref = distances.at(0);
 	for (const auto& agent_id : local_agents) {
 
 		// First will be the last agent to move, i.e. should not be handoff_agent
@@ -85,7 +99,7 @@ Helper_Agent_Info Heuristic::find_helper(const std::vector<Helper_Agent_Info>& h
 		}
 		const auto& agent_ref = state.agents.at(agent_id.id);
 		const auto& agent_coord = agent_ref.coordinate;
-		const auto& dist = dist_agent_ref.const_at(agent_coord, prev);
+		auto dist = distances.const_at(0, agent_coord, prev);
 		size_t holding_penalty = 0;
 
 		if (agent_ref.item.has_value() 
@@ -119,7 +133,7 @@ Helper_Agent_Distance Heuristic::get_helper_agents_distance(Coordinate source, C
 	size_t path_length = 1;
 	bool first = true;
 	while (true) {
-		auto& prev_dist = distances.at(walls_to_penetrate).const_at(source, prev);
+		auto prev_dist = distances.const_at(walls_to_penetrate, source, prev);
 		if (prev_dist.parent == source) {
 			auto helper = find_helper(helpers, handoff_agent, local_agents, first, state, source, { EMPTY_VAL, EMPTY_VAL }, path_length);
 			if (!helper.has_value()) {
@@ -178,7 +192,7 @@ Helper_Agent_Distance Heuristic::get_helper_agents_distance(Coordinate source, C
 		//first = false;
 	}
 	bool was_handed_off = helpers.size() > 1;
-	assert((distances.at(walls_to_penetrate).const_at(source, destination).g == path_length));
+	assert((distances.const_at(walls_to_penetrate, source, destination).g == path_length));
 	return { std::max(forward_length, reverse_length), was_handed_off };
 }
 
@@ -235,8 +249,49 @@ size_t Heuristic::get_heuristic_distance(const Location& location1, const Locati
 	return min_dist + wall_penalty;
 }
 
-// Main heuristic function, setup
+// Projection of the state the heuristic depends on: all agents, items which may be ingredients,
+// and occupied walls, which limit where held items can be put down
+void Heuristic::set_cache_key(const State& state, const Agent_Combination& agents, const Agent_Id& handoff_agent) const {
+	cache_key.clear();
+	size_t agent_mask = 0;
+	for (const auto& agent : agents) {
+		agent_mask |= size_t{ 1 } << agent.id;
+	}
+	cache_key.push_back(agent_mask);
+	cache_key.push_back(handoff_agent.id);
+	for (const auto& agent : state.agents) {
+		cache_key.push_back(convert(agent.coordinate));
+		cache_key.push_back(agent.item.has_value() ? static_cast<size_t>(agent.item.value()) : EMPTY_VAL);
+	}
+	for (const auto& item : state.items) {
+		bool is_ingredient = item.second == ingredient1 || item.second == ingredient2;
+		if (is_ingredient || environment.is_cell_type(item.first, Cell_Type::WALL)) {
+			cache_key.push_back(convert(item.first));
+			cache_key.push_back(is_ingredient ? static_cast<size_t>(item.second) : EMPTY_VAL);
+		}
+	}
+}
+
 size_t Heuristic::operator()(const State& state, const Agent_Combination& agents, const Agent_Id& handoff_agent) const {
+	++cache_lookups;
+	set_cache_key(state, agents, handoff_agent);
+	auto it = cache.find(cache_key);
+	if (it != cache.end()) {
+		++cache_hits;
+		return it->second;
+	}
+
+	auto h = calculate(state, agents, handoff_agent);
+	if (cache.size() >= MAX_CACHE_SIZE) {
+		cache.clear();
+	}
+	cache.emplace(cache_key, h);
+	return h;
+}
+
+// Main heuristic function, setup
+size_t Heuristic::calculate(const State& state, const Agent_Combination& agents, const Agent_Id& handoff_agent) const {
+	free_walls.update(state);
 	bool require_handoff_action = false;
 	std::vector<Location> locations1;
 	if (environment.is_type_stationary(ingredient1)) {
@@ -247,16 +302,93 @@ size_t Heuristic::operator()(const State& state, const Agent_Combination& agents
 	auto locations2 = environment.get_non_wall_locations(state, ingredient2);
 
 	size_t min_dist = EMPTY_VAL;
+	if (agents.empty()) {
+		return min_dist;
+	}
 
-	// Search all location combinations using all agents, and all agents minus handoff_agent
-	for (const auto& location1 : locations1) {
-		for (const auto& location2 : locations2) {
-			min_dist = std::min(min_dist, get_heuristic_distance(location1, location2, state, handoff_agent, agents, require_handoff_action));
+	// Search all location combinations using all agents, and all agents minus handoff_agent.
+	// Pairs are visited by increasing lower bound, and the helper agent walk stops once no pair can improve
+	calculate_pair_bounds(locations1, locations2, agents.size() - 1);
+	for (const auto& pair : pair_buffers.order) {
+		if (pair_buffers.bounds.at(pair) >= min_dist) {
+			break;
 		}
+		const auto& location1 = locations1.at(pair / locations2.size());
+		const auto& location2 = locations2.at(pair % locations2.size());
+		min_dist = std::min(min_dist, get_heuristic_distance(location1, location2, state, handoff_agent, agents, require_handoff_action));
+	}
+
+	// A single agent can not be faster than in the abstraction without other agents and items
+	if (agents.size() == 1 && handoff_agent.is_empty() && min_dist != EMPTY_VAL) {
+		min_dist = std::max(min_dist, pattern_database.get_cost(state, agents.agents.at(0), ingredient1, ingredient2));
 	}
 	return min_dist;
 }
 
+// bounds = min(forward, backward) distance + penalties, on packed distance entries.
+// Unreached pairs get bounds of at least Distances::UNREACHED.
+static void get_pair_bounds(const uint16_t* forward, const uint16_t* backward, const uint16_t* penalties,
+	uint16_t* bounds, size_t count) {
+
+	size_t i = 0;
+#ifdef HEURISTIC_SSE2
+	for (; i + 8 <= count; i += 8) {
+		auto forward_g = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(forward + i)), 2);
+		auto backward_g = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(backward + i)), 2);
+		auto penalty = _mm_loadu_si128(reinterpret_cast<const __m128i*>(penalties + i));
+		auto bound = _mm_adds_epu16(_mm_min_epi16(forward_g, backward_g), penalty);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(bounds + i), bound);
+	}
+#endif
+	for (; i < count; ++i) {
+		bounds[i] = static_cast<uint16_t>(std::min(forward[i] >> 2, backward[i] >> 2) + penalties[i]);
+	}
+}
+
+// The path found by get_helper_agents_distance is never shorter than the table distance, and the
+// table distance for the most walls is the minimum over all wall counts
+void Heuristic::calculate_pair_bounds(const std::vector<Location>& locations1, const std::vector<Location>& locations2,
+	size_t walls) const {
+
+	auto& buffers = pair_buffers;
+	size_t count = locations1.size() * locations2.size();
+	buffers.forward.resize(count);
+	buffers.backward.resize(count);
+	buffers.penalties.resize(count);
+	buffers.bounds.resize(count);
+	buffers.order.resize(count);
+
+	// Gather the distance entries of all pairs into contiguous rows
+	bool is_forward_allowed = !environment.is_type_stationary(ingredient1);
+	for (size_t i = 0; i < locations1.size(); ++i) {
+		const auto& location1 = locations1.at(i);
+		auto cell1 = convert(location1.coordinate);
+		for (size_t j = 0; j < locations2.size(); ++j) {
+			const auto& location2 = locations2.at(j);
+			auto cell2 = convert(location2.coordinate);
+			auto pair = i * locations2.size() + j;
+			distances.ensure_row(walls, cell2);
+			if (is_forward_allowed) {
+				distances.ensure_row(walls, cell1);
+			}
+			buffers.backward[pair] = distances.get_raw(distances.get_index(walls, cell2, cell1));
+			buffers.forward[pair] = is_forward_allowed
+				? distances.get_raw(distances.get_index(walls, cell1, cell2))
+				: buffers.backward[pair];
+			buffers.penalties[pair] = static_cast<uint16_t>((location1.from_wall ? 1 : 0) + (location2.from_wall ? 1 : 0));
+		}
+	}
+
+	get_pair_bounds(buffers.forward.data(), buffers.backward.data(), buffers.penalties.data(), buffers.bounds.data(), count);
+
+	for (size_t pair = 0; pair < count; ++pair) {
+		buffers.order[pair] = pair;
+	}
+	std::stable_sort(buffers.order.begin(), buffers.order.end(), [&buffers](size_t lhs, size_t rhs) {
+		return buffers.bounds[lhs] < buffers.bounds[rhs];
+	});
+}
+
 size_t Heuristic::convert(const Coordinate& coord1) const {
 	return coord1.first * environment.get_height() + coord1.second;
 }
@@ -265,7 +397,7 @@ void Heuristic::print_distances(Coordinate coordinate, size_t agent_number) cons
 	std::cout << "\nPrinting distances for " << agent_number << " agents from (" << coordinate.first << ", " << coordinate.second << ")" << std::endl;
 	for (size_t y = 0; y < environment.get_height(); ++y) {
 		for (size_t x = 0; x < environment.get_width(); ++x) {
-			const auto& temp = distances.at(agent_number - 1).const_at(coordinate, { x,y });
+			auto temp = distances.const_at(agent_number - 1, coordinate, { x,y });
 			std::cout << (temp.g == EMPTY_VAL ? "--" : (temp.g < 10 ? "0" : "") + std::to_string(temp.g)) << " ";
 		}
 		std::cout << std::endl;
@@ -273,13 +405,89 @@ void Heuristic::print_distances(Coordinate coordinate, size_t agent_number) cons
 	std::cout << "\nPrinting directions for " << agent_number << " agents from (" << coordinate.first << ", " << coordinate.second << ")" << std::endl;
 	for (size_t y = 0; y < environment.get_height(); ++y) {
 		for (size_t x = 0; x < environment.get_width(); ++x) {
-			const auto& temp = distances.at(agent_number - 1).const_at(coordinate, { x,y });
+			auto temp = distances.const_at(agent_number - 1, coordinate, { x,y });
 			std::cout << (temp.g == EMPTY_VAL ? '-' : static_cast<char>(get_direction({ x, y }, temp.parent))) << " ";
 		}
 		std::cout << std::endl;
 	}
 }
 
+// Scratch buffers for the distance search from one source, one set per init thread
+struct Distance_Search_Buffers {
+	Distance_Search_Buffers(size_t wall_counts, size_t cells)
+		: temp_distances(wall_counts, std::vector<Search_Distance>(cells)), frontier() {}
+
+	std::vector<std::vector<Search_Distance>> temp_distances;	// Per amount of walls intersected
+	std::deque<Search_Entry> frontier;
+};
+
+// Distances from one source through at most max_walls walls, written to the row of the source
+static void search_source(const Environment& environment, const Distances& distances, size_t max_walls,
+	const Coordinate& source, const std::vector<Coordinate>& coordinates, Distance_Search_Buffers& buffers,
+	Distance_Block* target) {
+
+	auto& temp_distances = buffers.temp_distances;
+	auto& frontier = buffers.frontier;
+	for (size_t walls = 0; walls <= max_walls; ++walls) {
+		std::fill(temp_distances.at(walls).begin(), temp_distances.at(walls).end(), Search_Distance{});
+	}
+
+	Search_Entry origin{ source, 0, 0, 0 };
+	frontier.push_back(origin);
+	temp_distances.at(0).at(distances.convert(source)).g = 0;
+	while (!frontier.empty()) {
+		auto& current = frontier.front();
+		auto is_current_wall = environment.is_cell_type(current.coord, Cell_Type::WALL);
+
+		// Check all directions
+		for (const auto& destination : environment.get_neighbours(current.coord)) {
+			if (!environment.is_inbounds(destination)) {
+				continue;
+			}
+
+			auto is_next_wall = environment.is_cell_type(destination, Cell_Type::WALL);
+
+			// Check if path is valid
+			if (is_current_wall && is_next_wall) {
+				continue;
+			}
+
+			// Record
+			auto& recorded_dist = temp_distances.at(current.walls).at(distances.convert(destination));
+			if (recorded_dist.g == EMPTY_VAL 
+				|| current.dist + 1 < recorded_dist.g
+				|| (current.dist +1 == recorded_dist.g 
+					&& recorded_dist.wall_g > current.wall_g)) {
+				
+				recorded_dist.g = current.dist + 1;
+				recorded_dist.parent = current.coord;
+				recorded_dist.wall_g = (is_next_wall ? current.dist + 1 : current.wall_g);
+				size_t wall_count = current.walls + (is_next_wall ? 1 : 0);
+				if (wall_count <= max_walls) {
+					frontier.emplace_back(destination, current.dist + 1, wall_count, (is_next_wall ? current.dist + 1 : current.wall_g));
+				}
+			}
+		}
+		frontier.pop_front();
+	}
+
+	// Recorded the smallest dist among the distances from different wall values
+	for (const auto& destination : coordinates) {
+		Distance_Entry ref_dist;
+		for (size_t walls = 0; walls <= max_walls; ++walls) {
+			const auto& dist = temp_distances.at(walls).at(distances.convert(destination));
+			if (ref_dist.g == EMPTY_VAL || dist.g <= ref_dist.g) {
+				ref_dist = { dist.g, dist.parent };
+			}
+		}
+		distances.set(target, max_walls, source, destination, ref_dist);
+	}
+
+	//print_distances({ 5,5 }, 2);
+	//print_distances({ 1,1 }, 2);
+	//print_distances({ 5,0 }, 2);
+}
+
 // All pairs shortest path for all amounts of agents, taking wall-handover in to account
 void Heuristic::init() {
 	// Get all possible coordinates
@@ -290,71 +498,64 @@ void Heuristic::init() {
 		}
 	}
 
-	// Loop agent sizes
-	for (size_t current_agents = 0; current_agents < environment.get_number_of_agents(); ++current_agents) {
-		size_t max_walls = current_agents;
-		distances.emplace_back(environment.get_width(), environment.get_height());
-		auto& final_dist = distances.back();
-
-		// Loop all source coordiantes
-		for (const auto& source : coordinates) {
-			std::vector<std::vector<Distance_Entry>> temp_distances(
-				environment.get_number_of_agents(), std::vector<Distance_Entry>(environment.get_width() * environment.get_height()));
-
-			Search_Entry origin{ source, 0, 0, 0 };
-			std::deque<Search_Entry> frontier;
-			frontier.push_back(origin);
-			temp_distances.at(0).at(convert(source)) = 0;
-			while (!frontier.empty()) {
-				auto& current = frontier.front();
-				auto is_current_wall = environment.is_cell_type(current.coord, Cell_Type::WALL);
-
-				// Check all directions
-				for (const auto& destination : environment.get_neighbours(current.coord)) {
-					if (!environment.is_inbounds(destination)) {
-						continue;
-					}
-
-					auto is_next_wall = environment.is_cell_type(destination, Cell_Type::WALL);
-
-					// Check if path is valid
-					if (is_current_wall && is_next_wall) {
-						continue;
-					}
-
-					// Record
-					auto& recorded_dist = temp_distances.at(current.walls).at(convert(destination));
-					if (recorded_dist.g == EMPTY_VAL 
-						|| current.dist + 1 < recorded_dist.g
-						|| (current.dist +1 == recorded_dist.g 
-							&& recorded_dist.wall_g > current.wall_g)) {
-						
-						recorded_dist.g = current.dist + 1;
-						recorded_dist.parent = current.coord;
-						recorded_dist.wall_g = (is_next_wall ? current.dist + 1 : current.wall_g);
-						size_t wall_count = current.walls + (is_next_wall ? 1 : 0);
-						if (wall_count <= max_walls) {
-							frontier.emplace_back(destination, current.dist + 1, wall_count, (is_next_wall ? current.dist + 1 : current.wall_g));
-						}
-					}
-				}
-				frontier.pop_front();
+	size_t agent_count = environment.get_number_of_agents();
+	distances = Distances(environment.get_width(), environment.get_height(), agent_count);
+	if (coordinates.size() > LAZY_DISTANCES_CELLS) {
+		init_lazy(coordinates);
+		return;
+	}
+	distances.blocks = get_cached_distances(get_level_key(environment), distances.block_count,
+		[&](Distance_Block* target) {
+
+		Distance_Block unreached_block;
+		unreached_block.entries.fill(static_cast<uint16_t>(Distances::UNREACHED << 2));
+		std::fill_n(target, distances.block_count, unreached_block);
+
+		// Every (agent size, source) pair writes its own row, so sources are distributed over threads
+		size_t job_count = agent_count * coordinates.size();
+		size_t thread_count = std::max(std::min<size_t>(std::thread::hardware_concurrency(), job_count), (size_t)1);
+		std::atomic<size_t> next_job = 0;
+		auto worker = [&]() {
+			Distance_Search_Buffers buffers(agent_count, coordinates.size());
+			for (size_t job = next_job++; job < job_count; job = next_job++) {
+				search_source(environment, distances, job / coordinates.size(), coordinates.at(job % coordinates.size()),
+					coordinates, buffers, target);
 			}
+		};
 
-			// Recorded the smallest dist among the distances from different wall values
-			for (const auto& dist : temp_distances) {
-				for (const auto& destination : coordinates) {
-					auto& ref_dist = final_dist.at(source, destination);
-					if (ref_dist.g == EMPTY_VAL || dist.at(convert(destination)).g <= ref_dist.g) {
-						ref_dist = dist.at(convert(destination));
-					}
-				}
-			}
+		std::vector<std::thread> threads;
+		for (size_t i = 1; i < thread_count; ++i) {
+			threads.emplace_back(worker);
+		}
+		worker();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	});
+}
 
+// Rows are searched on first use and kept for the lifetime of the table, which is shared in the process
+// but not persisted. Rows from stations are searched up front, as most queries start or end there.
+void Heuristic::init_lazy(const std::vector<Coordinate>& coordinates) {
+	size_t agent_count = environment.get_number_of_agents();
+	auto shape = distances;
+	auto rows = get_cached_lazy_distances(get_level_key(environment), [&]() {
+		auto buffers = std::make_shared<Distance_Search_Buffers>(agent_count, coordinates.size());
+		return std::make_shared<Lazy_Distance_Rows>(shape.cells, agent_count, shape.block_count,
+			[environment = environment, shape, coordinates, buffers](size_t walls, size_t source, Distance_Block* target) {
+			search_source(environment, shape, walls, coordinates.at(source), coordinates, *buffers, target);
+		});
+	});
+	distances.blocks = { rows, rows->blocks.get() };
+	distances.lazy_rows = rows;
+
+	for (const auto& coordinate : coordinates) {
+		if (!environment.is_cell_type(coordinate, Cell_Type::CUTTING_STATION)
+			&& !environment.is_cell_type(coordinate, Cell_Type::DELIVERY_STATION)) {
+			continue;
+		}
+		for (size_t walls = 0; walls < agent_count; ++walls) {
+			distances.ensure_row(walls, distances.convert(coordinate));
 		}
 	}
-
-	//print_distances({ 5,5 }, 2);
-	//print_distances({ 1,1 }, 2);
-	//print_distances({ 5,0 }, 2);
-}
\ No newline at end of file
+}
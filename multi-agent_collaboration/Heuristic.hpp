@@ -1,34 +1,146 @@
 #pragma once
 
 #include "Environment.hpp"
+#include "Free_Wall_Field.hpp"
+#include "Pattern_Database.hpp"
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 
 struct Distance_Entry {
-	Distance_Entry() :g(EMPTY_VAL), parent(EMPTY_VAL, EMPTY_VAL), wall_g(0) {}
-	Distance_Entry(size_t g) :g(g), parent(EMPTY_VAL, EMPTY_VAL), wall_g(0) {}
-	Distance_Entry(size_t g, Coordinate parent) : g(g), parent(parent), wall_g(0) {}
-	Distance_Entry(size_t g, Coordinate parent, size_t wall_g) : g(g), parent(parent), wall_g(wall_g) {}
+	Distance_Entry() :g(EMPTY_VAL), parent(EMPTY_VAL, EMPTY_VAL) {}
+	Distance_Entry(size_t g) :g(g), parent(EMPTY_VAL, EMPTY_VAL) {}
+	Distance_Entry(size_t g, Coordinate parent) : g(g), parent(parent) {}
 	size_t g;
 	Coordinate parent;
-	size_t wall_g;
 };
+
+// 64 byte aligned block of packed distance entries
+struct alignas(64) Distance_Block {
+	static constexpr size_t size = 32;
+	std::array<uint16_t, size> entries;
+};
+
+// Storage of a lazily computed distance table, a row (walls, source cell) is searched on its first query.
+// The blocks are left uninitialised, so only pages of computed rows take up memory.
+struct Lazy_Distance_Rows {
+	using Compute = std::function<void(size_t walls, size_t source, Distance_Block* target)>;
+
+	Lazy_Distance_Rows(size_t cells, size_t wall_counts, size_t block_count, Compute compute)
+		: blocks(new Distance_Block[block_count]), ready(new std::atomic<bool>[wall_counts * cells]),
+		mutex(), compute(std::move(compute)), cells(cells) {
+		for (size_t row = 0; row < wall_counts * cells; ++row) {
+			ready[row] = false;
+		}
+	}
+
+	void ensure(size_t walls, size_t source) {
+		auto row = walls * cells + source;
+		if (ready[row].load(std::memory_order_acquire)) {
+			return;
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!ready[row].load(std::memory_order_relaxed)) {
+			compute(walls, source, blocks.get());
+			ready[row].store(true, std::memory_order_release);
+		}
+	}
+
+	std::unique_ptr<Distance_Block[]> blocks;
+	std::unique_ptr<std::atomic<bool>[]> ready;
+	std::mutex mutex;
+	Compute compute;
+	size_t cells;
+};
+
+// All pairs distances for each amount of walls penetrated, stored in one contiguous buffer indexed by
+// (walls, source cell, destination cell). An entry packs the distance in the upper 14 bits and the
+// direction from the destination towards its parent in the lower 2 bits. The source itself is the
+// only entry with distance 0, and neither the source nor unreached entries have a parent.
+// The buffer is immutable once computed and shared between copies, see Heuristic_Cache. Tables of
+// large levels are lazy, where rows must be ensured before their entries are read.
 struct Distances {
-	Distances(size_t width, size_t height)
-		: distances(width* height, std::vector<Distance_Entry>(width* height)),
-		width(width), height(height) {}
-	std::vector<std::vector<Distance_Entry>> distances;
+	static constexpr uint16_t UNREACHED = 0x3FFF;
+
+	Distances() : blocks(), lazy_rows(), width(0), height(0), cells(0), block_count(0) {}
+	Distances(size_t width, size_t height, size_t wall_counts)
+		: blocks(), lazy_rows(), width(width), height(height), cells(width* height),
+		block_count((wall_counts* cells* cells + Distance_Block::size - 1) / Distance_Block::size) {
+		assert(cells < UNREACHED);
+	}
+
+	std::shared_ptr<const Distance_Block> blocks;
+	std::shared_ptr<Lazy_Distance_Rows> lazy_rows;
 	size_t width;
 	size_t height;
+	size_t cells;
+	size_t block_count;
+
 	constexpr size_t convert(const Coordinate& coord1) const {
 		return coord1.first * height + coord1.second;
 	}
 
-	const Distance_Entry& const_at(Coordinate coord1, Coordinate coord2) const {
-		return distances.at(convert(coord1)).at(convert(coord2));
+	size_t get_index(size_t walls, size_t cell1, size_t cell2) const {
+		return (walls * cells + cell1) * cells + cell2;
 	}
 
-	Distance_Entry& at(Coordinate coord1, Coordinate coord2) {
-		return distances.at(convert(coord1)).at(convert(coord2));
+	void ensure_row(size_t walls, size_t cell1) const {
+		if (lazy_rows) {
+			lazy_rows->ensure(walls, cell1);
+		}
+	}
+
+	uint16_t get_raw(size_t index) const {
+		return blocks.get()[index / Distance_Block::size].entries[index % Distance_Block::size];
+	}
+
+	size_t get_g(size_t index) const {
+		auto g = blocks.get()[index / Distance_Block::size].entries[index % Distance_Block::size] >> 2;
+		return g == UNREACHED ? EMPTY_VAL : g;
+	}
+
+	Distance_Entry const_at(size_t walls, Coordinate coord1, Coordinate coord2) const {
+		ensure_row(walls, convert(coord1));
+		auto index = get_index(walls, convert(coord1), convert(coord2));
+		auto value = blocks.get()[index / Distance_Block::size].entries[index % Distance_Block::size];
+		size_t g = value >> 2;
+		if (g == UNREACHED) {
+			return {};
+		}
+		if (g == 0) {
+			return { 0 };
+		}
+		switch (value & 3) {
+		case 0: return { g, { coord2.first, coord2.second - 1 } };
+		case 1: return { g, { coord2.first + 1, coord2.second } };
+		case 2: return { g, { coord2.first, coord2.second + 1 } };
+		default: return { g, { coord2.first - 1, coord2.second } };
+		}
+	}
+
+	// Writes into a buffer of block_count blocks which is being computed
+	void set(Distance_Block* target, size_t walls, Coordinate coord1, Coordinate coord2, const Distance_Entry& entry) const {
+		auto value = static_cast<uint16_t>(UNREACHED << 2);
+		if (entry.g != EMPTY_VAL) {
+			assert(entry.g < UNREACHED);
+			uint16_t direction = 0;
+			if (entry.g != 0) {
+				if (entry.parent.first == coord2.first + 1) direction = 1;
+				else if (entry.parent.second == coord2.second + 1) direction = 2;
+				else if (entry.parent.first + 1 == coord2.first) direction = 3;
+			}
+			value = static_cast<uint16_t>((entry.g << 2) | direction);
+		}
+		auto index = get_index(walls, convert(coord1), convert(coord2));
+		target[index / Distance_Block::size].entries[index % Distance_Block::size] = value;
 	}
 };
 
@@ -64,6 +176,25 @@ struct Helper_Agent_Info {
 	}
 };
 
+// Scratch buffers for the lower bounds of all location pairs, indexed by location1 * locations2 + location2
+struct Location_Pair_Buffers {
+	std::vector<uint16_t> forward;		// Packed distance entries from location1 to location2
+	std::vector<uint16_t> backward;		// Packed distance entries from location2 to location1
+	std::vector<uint16_t> penalties;
+	std::vector<uint16_t> bounds;
+	std::vector<size_t> order;
+};
+
+struct Heuristic_Key_Hash {
+	size_t operator()(const std::vector<size_t>& key) const {
+		size_t hash = key.size();
+		for (const auto& value : key) {
+			hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		}
+		return hash;
+	}
+};
+
 #define INFINITE_HEURISTIC 1000
 class Heuristic {
 public:
@@ -72,6 +203,7 @@ public:
 	void set(Ingredient ingredient1, Ingredient ingredient2, const Agent_Combination& agents,
 		const Agent_Id& handoff_agent);
 	std::pair<size_t, Direction> get_dist_direction(Coordinate source, Coordinate dest, size_t walls) const;
+	std::string get_cache_stats() const;
 
 private:
 	Helper_Agent_Distance  get_helper_agents_distance(Coordinate source, Coordinate destination, const State& state,
@@ -81,18 +213,32 @@ private:
 	size_t get_heuristic_distance(const Location& location1, const Location& location2, const State& state, 
 		const Agent_Id& handoff_agent, const Agent_Combination& local_agents, const bool& require_handoff_action) const;
 	
+	size_t calculate(const State& state, const Agent_Combination& agents, const Agent_Id& handoff_agent) const;
+	void calculate_pair_bounds(const std::vector<Location>& locations1, const std::vector<Location>& locations2,
+		size_t walls) const;
+	void set_cache_key(const State& state, const Agent_Combination& agents, const Agent_Id& handoff_agent) const;
 	bool are_items_available (const Location& location1, const Location& location2, const State& state, const Agent_Combination& local_agents) const;
 	size_t convert(const Coordinate& coord1) const;
 	void print_distances(Coordinate coordinate, size_t agent_number) const;
 	void init();
+	void init_lazy(const std::vector<Coordinate>& coordinates);
 	size_t get_distance_to_nearest_wall(Coordinate agent_coord, Coordinate blocked, const State& state) const;
 	Helper_Agent_Info find_helper(const std::vector<Helper_Agent_Info>& helpers, const Agent_Id handoff_agent, const Agent_Combination& local_agents, const bool first,
 		const State& state, const Coordinate& prev, const Coordinate& next, const size_t path_length) const;
 
-	std::vector<Distances> distances;	// Vector index is the amount of walls intersected on the path
+	Distances distances;	// Per amount of walls intersected on the path
 	Environment environment;
 	Ingredient ingredient1;
 	Ingredient ingredient2;
 	std::optional<Agent_Id> handoff_agent;
 	std::vector<Agent_Combination> agent_combinations;
+	mutable Free_Wall_Field free_walls;	// Of the last evaluated state
+	mutable Location_Pair_Buffers pair_buffers;
+	Pattern_Database pattern_database;	// Lower bound for searches with a single agent
+
+	// h-values for the current configuration, keyed by the part of the state they depend on
+	mutable std::unordered_map<std::vector<size_t>, size_t, Heuristic_Key_Hash> cache;
+	mutable std::vector<size_t> cache_key;
+	mutable size_t cache_lookups;
+	mutable size_t cache_hits;
 };
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include "Heuristic_Cache.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr uint64_t CACHE_MAGIC = 0x5453494448434D41;	// "AMCHDIST"
+constexpr uint64_t CACHE_VERSION = 1;
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+// Padded to a full block, so the mapped blocks keep their alignment
+struct Cache_Header {
+	uint64_t magic;
+	uint64_t version;
+	uint64_t key;
+	uint64_t block_count;
+	uint64_t unused[4];
+};
+static_assert(sizeof(Cache_Header) == sizeof(Distance_Block), "Cache header must fill one block");
+
+static std::mutex cache_mutex;
+static std::string cache_directory;
+static std::map<uint64_t, std::weak_ptr<const Distance_Block>> loaded_tables;
+static std::map<uint64_t, std::weak_ptr<Lazy_Distance_Rows>> lazy_tables;
+
+void set_heuristic_cache_directory(const std::string& directory) {
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	cache_directory = directory;
+}
+
+static uint64_t hash_combine(uint64_t hash, uint64_t value) {
+	for (size_t i = 0; i < sizeof(value); ++i) {
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+uint64_t get_level_key(const Environment& environment) {
+	uint64_t hash = hash_combine(FNV_OFFSET, CACHE_VERSION);
+	hash = hash_combine(hash, environment.get_width());
+	hash = hash_combine(hash, environment.get_height());
+	hash = hash_combine(hash, environment.get_number_of_agents());
+	for (size_t x = 0; x < environment.get_width(); ++x) {
+		for (size_t y = 0; y < environment.get_height(); ++y) {
+			hash = hash_combine(hash, environment.is_cell_type({ x, y }, Cell_Type::WALL) ? 1 : 0);
+		}
+	}
+	return hash;
+}
+
+static std::string get_cache_path(uint64_t key) {
+	std::stringstream path;
+	path << cache_directory << "/distances_" << std::hex << key << ".bin";
+	return path.str();
+}
+
+static bool is_header_valid(const Cache_Header& header, uint64_t key, size_t block_count) {
+	return header.magic == CACHE_MAGIC
+		&& header.version == CACHE_VERSION
+		&& header.key == key
+		&& header.block_count == block_count;
+}
+
+// Maps the file read-only, the mapping is released with the last reference to the table
+static std::shared_ptr<const Distance_Block> map_file(const std::string& path, uint64_t key, size_t block_count) {
+	size_t size = sizeof(Cache_Header) + block_count * sizeof(Distance_Block);
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return nullptr;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || static_cast<size_t>(file_size.QuadPart) != size) {
+		CloseHandle(file);
+		return nullptr;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (mapping == nullptr) {
+		return nullptr;
+	}
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (data == nullptr) {
+		return nullptr;
+	}
+	auto unmap = [](const void* data) { UnmapViewOfFile(data); };
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file == -1) {
+		return nullptr;
+	}
+	struct stat file_info;
+	if (fstat(file, &file_info) != 0 || static_cast<size_t>(file_info.st_size) != size) {
+		close(file);
+		return nullptr;
+	}
+	void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, file, 0);
+	close(file);
+	if (data == MAP_FAILED) {
+		return nullptr;
+	}
+	auto unmap = [size](const void* data) { munmap(const_cast<void*>(data), size); };
+#endif
+
+	if (!is_header_valid(*static_cast<const Cache_Header*>(data), key, block_count)) {
+		unmap(data);
+		return nullptr;
+	}
+	std::shared_ptr<const void> owner(data, unmap);
+	return { owner, reinterpret_cast<const Distance_Block*>(static_cast<const char*>(data) + sizeof(Cache_Header)) };
+}
+
+// Written under a unique name and renamed, so no process maps a partially written file
+static void write_file(const std::string& path, uint64_t key, const std::vector<Distance_Block>& blocks) {
+	std::error_code error;
+	std::filesystem::create_directories(cache_directory, error);
+
+	std::stringstream temp_path;
+	temp_path << path << '.' << std::this_thread::get_id() << '.'
+		<< std::chrono::steady_clock::now().time_since_epoch().count() << ".tmp";
+
+	Cache_Header header{ CACHE_MAGIC, CACHE_VERSION, key, blocks.size(), {} };
+	std::ofstream file(temp_path.str(), std::ios::binary);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(Distance_Block));
+	file.close();
+
+	if (file) {
+		std::filesystem::rename(temp_path.str(), path, error);
+	}
+	if (!file || error) {
+		std::filesystem::remove(temp_path.str(), error);
+		PRINT(Print_Category::UTILS, Print_Level::DEBUG, "Could not write heuristic cache " + path + '\n');
+	}
+}
+
+std::shared_ptr<const Distance_Block> get_cached_distances(uint64_t key, size_t block_count,
+	const std::function<void(Distance_Block*)>& compute) {
+
+	// Held while computing, so concurrent planners wait for the first instead of repeating it
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	auto loaded_it = loaded_tables.find(key);
+	if (loaded_it != loaded_tables.end()) {
+		if (auto table = loaded_it->second.lock()) {
+			return table;
+		}
+	}
+
+	std::shared_ptr<const Distance_Block> table;
+	if (!cache_directory.empty()) {
+		table = map_file(get_cache_path(key), key, block_count);
+	}
+
+	if (!table) {
+		auto blocks = std::make_shared<std::vector<Distance_Block>>(block_count);
+		compute(blocks->data());
+		if (!cache_directory.empty()) {
+			write_file(get_cache_path(key), key, *blocks);
+		}
+		table = { blocks, blocks->data() };
+	}
+
+	loaded_tables[key] = table;
+	return table;
+}
+
+std::shared_ptr<Lazy_Distance_Rows> get_cached_lazy_distances(uint64_t key,
+	const std::function<std::shared_ptr<Lazy_Distance_Rows>()>& create) {
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	auto lazy_it = lazy_tables.find(key);
+	if (lazy_it != lazy_tables.end()) {
+		if (auto table = lazy_it->second.lock()) {
+			return table;
+		}
+	}
+	auto table = create();
+	lazy_tables[key] = table;
+	return table;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Environment.hpp"
+#include "Heuristic.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Distance tables only depend on the level layout and the agent count. A computed table is shared by
+// all heuristics in the process, and when a cache directory is set it is written to disk once and
+// memory mapped read-only by later processes, which then share its pages.
+
+// Enables persisting tables in the directory, an empty directory disables it (default)
+void set_heuristic_cache_directory(const std::string& directory);
+
+// Hash of the wall layout, size and agent count of the level
+uint64_t get_level_key(const Environment& environment);
+
+// Returns the table of block_count blocks for the key, compute fills it if it is not cached
+std::shared_ptr<const Distance_Block> get_cached_distances(uint64_t key, size_t block_count,
+	const std::function<void(Distance_Block*)>& compute);
+
+// Returns the lazy table for the key, create makes it if no heuristic in the process holds one
+std::shared_ptr<Lazy_Distance_Rows> get_cached_lazy_distances(uint64_t key,
+	const std::function<std::shared_ptr<Lazy_Distance_Rows>()>& create);
@@ -0,0 +1,140 @@
+#include "Pattern_Database.hpp"
+#include "Heuristic.hpp"
+
+#include <algorithm>
+
+constexpr size_t NEIGHBOUR_COUNT = 4;
+
+Pattern_Database::Pattern_Database()
+	: height(0), cells(0), interaction_costs(), neighbours(), floor_distances(),
+	cutting_cells(), delivery_cells(), cells1(), cells2() {}
+
+Pattern_Database::Pattern_Database(const Environment& environment, const Distances& distances)
+	: height(environment.get_height()), cells(environment.get_width()* environment.get_height()),
+	interaction_costs(cells* cells, UNREACHABLE), neighbours(cells* NEIGHBOUR_COUNT, EMPTY_VAL),
+	floor_distances(cells* cells, UNREACHABLE), cutting_cells(), delivery_cells(), cells1(), cells2() {
+
+	std::vector<Coordinate> floor;
+	for (size_t x = 0; x < environment.get_width(); ++x) {
+		for (size_t y = 0; y < height; ++y) {
+			Coordinate coordinate{ x, y };
+			auto cell = convert(coordinate);
+			if (!environment.is_cell_type(coordinate, Cell_Type::WALL)) {
+				floor.push_back(coordinate);
+			}
+			if (environment.is_cell_type(coordinate, Cell_Type::CUTTING_STATION)) {
+				cutting_cells.push_back(cell);
+			}
+			if (environment.is_cell_type(coordinate, Cell_Type::DELIVERY_STATION)) {
+				delivery_cells.push_back(cell);
+			}
+
+			size_t i = 0;
+			for (const auto& neighbour : environment.get_neighbours(coordinate)) {
+				if (environment.is_inbounds(neighbour) && !environment.is_cell_type(neighbour, Cell_Type::WALL)) {
+					neighbours.at(cell * NEIGHBOUR_COUNT + i) = convert(neighbour);
+				}
+				++i;
+			}
+		}
+	}
+
+	// Floor distances without handing items over walls
+	for (const auto& source : floor) {
+		for (const auto& destination : floor) {
+			auto g = distances.const_at(0, source, destination).g;
+			floor_distances.at(convert(source) * cells + convert(destination)) =
+				static_cast<uint8_t>(std::min<size_t>(g, UNREACHABLE));
+		}
+	}
+
+	// Moves from each floor cell to stand next to the target, plus the move into it
+	for (size_t target = 0; target < cells; ++target) {
+		for (const auto& coordinate : floor) {
+			auto cell = convert(coordinate);
+			size_t cost = UNREACHABLE;
+			for (size_t i = 0; i < NEIGHBOUR_COUNT; ++i) {
+				auto neighbour = neighbours.at(target * NEIGHBOUR_COUNT + i);
+				if (neighbour != EMPTY_VAL) {
+					cost = std::min<size_t>(cost, floor_distances.at(cell * cells + neighbour) + 1);
+				}
+			}
+			interaction_costs.at(target * cells + cell) = static_cast<uint8_t>(std::min<size_t>(cost, UNREACHABLE));
+		}
+	}
+}
+
+// Lower bound on the actions for the agent alone to perform the recipe, 0 if the abstraction has no solution,
+// e.g. when the missing ingredient is held by another agent
+size_t Pattern_Database::get_cost(const State& state, const Agent_Id& agent, Ingredient ingredient1, Ingredient ingredient2) const {
+	if (cells == 0) {
+		return 0;	// Not built
+	}
+	const auto& agent_ref = state.agents.at(agent.id);
+	auto agent_cell = convert(agent_ref.coordinate);
+	bool is_stationary = ingredient1 == Ingredient::CUTTING || ingredient1 == Ingredient::DELIVERY;
+	get_cells(state, ingredient1, cells1);
+	get_cells(state, ingredient2, cells2);
+
+	size_t cost = UNREACHABLE;
+	if (agent_ref.item == ingredient2) {
+		for (const auto& target : cells1) {
+			cost = std::min(cost, get_interaction_cost(target, agent_cell));
+		}
+	}
+	else if (!is_stationary && agent_ref.item == ingredient1) {
+		for (const auto& target : cells2) {
+			cost = std::min(cost, get_interaction_cost(target, agent_cell));
+		}
+	}
+	else {
+		cost = get_carry_cost(agent_cell, cells2, cells1);
+		if (!is_stationary) {
+			cost = std::min(cost, get_carry_cost(agent_cell, cells1, cells2));
+		}
+	}
+	return cost >= UNREACHABLE ? 0 : cost;
+}
+
+size_t Pattern_Database::convert(const Coordinate& coordinate) const {
+	return coordinate.first * height + coordinate.second;
+}
+
+size_t Pattern_Database::get_interaction_cost(size_t target, size_t cell) const {
+	return interaction_costs[target * cells + cell];
+}
+
+// Pick up one of the carried items from a neighbouring floor cell, and bring it to one of the targets
+size_t Pattern_Database::get_carry_cost(size_t agent_cell, const std::vector<size_t>& carried, const std::vector<size_t>& targets) const {
+	size_t cost = UNREACHABLE;
+	for (const auto& item_cell : carried) {
+		for (size_t i = 0; i < NEIGHBOUR_COUNT; ++i) {
+			auto pickup_cell = neighbours[item_cell * NEIGHBOUR_COUNT + i];
+			if (pickup_cell == EMPTY_VAL) {
+				continue;
+			}
+			size_t pickup_cost = floor_distances[agent_cell * cells + pickup_cell] + 1;
+			if (pickup_cost >= cost) {
+				continue;
+			}
+			for (const auto& target : targets) {
+				cost = std::min(cost, pickup_cost + get_interaction_cost(target, pickup_cell));
+			}
+		}
+	}
+	return cost;
+}
+
+void Pattern_Database::get_cells(const State& state, Ingredient ingredient, std::vector<size_t>& result) const {
+	switch (ingredient) {
+	case Ingredient::CUTTING: result = cutting_cells; return;
+	case Ingredient::DELIVERY: result = delivery_cells; return;
+	default: break;
+	}
+	result.clear();
+	for (const auto& item : state.items) {
+		if (item.second == ingredient) {
+			result.push_back(convert(item.first));
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Environment.hpp"
+#include "State.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct Distances;
+
+// Single agent abstraction of a recipe step, keeping only the agent cell, its held item and the cells
+// of the two ingredients. Other agents and items are ignored, which makes the cost admissible for
+// searches where one agent acts alone. The database stores the moves from each floor cell until an
+// agent has interacted with each target cell (walls, stations), saturated to a byte.
+class Pattern_Database {
+public:
+	Pattern_Database();
+	Pattern_Database(const Environment& environment, const Distances& distances);
+	size_t get_cost(const State& state, const Agent_Id& agent, Ingredient ingredient1, Ingredient ingredient2) const;
+
+private:
+	static constexpr uint8_t UNREACHABLE = 255;
+
+	size_t	convert(const Coordinate& coordinate) const;
+	size_t	get_interaction_cost(size_t target, size_t cell) const;
+	size_t	get_carry_cost(size_t agent_cell, const std::vector<size_t>& carried, const std::vector<size_t>& targets) const;
+	void	get_cells(const State& state, Ingredient ingredient, std::vector<size_t>& result) const;
+
+	size_t					height;
+	size_t					cells;
+	std::vector<uint8_t>	interaction_costs;	// Indexed by target cell * cells + agent cell
+	std::vector<size_t>		neighbours;			// Floor neighbours, 4 per cell, EMPTY_VAL if not floor
+	std::vector<uint8_t>	floor_distances;	// Between floor cells without passing walls, saturated
+	std::vector<size_t>		cutting_cells;
+	std::vector<size_t>		delivery_cells;
+
+	// Lookup scratch
+	mutable std::vector<size_t> cells1;
+	mutable std::vector<size_t> cells2;
+};
@@ -2,6 +2,7 @@
 #include "BFS.hpp"
 #include "A_Star.hpp"
 #include "Search.hpp"
+#include "Reservation_Table.hpp"
 #include "Search_Trimmer.hpp"
 #include "Utils.hpp"
 #include "Recogniser.hpp"
@@ -14,19 +15,28 @@
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
+#include <tuple>
 
 
 
 constexpr auto INITIAL_DEPTH_LIMIT = 30;
 constexpr auto GAMMA = 1.01;
 constexpr auto GAMMA2 = 1.02;
-
-Planner_Mac::Planner_Mac(Environment environment, Agent_Id planning_agent, const State& initial_state, size_t seed)
-	: Planner_Impl(environment, planning_agent), time_step(0),
+constexpr auto PLAN_REUSE = true;	// Skip planning while other agents follow the predicted plan
+constexpr auto RECOGNISER_ESTIMATES = false;	// Goals without the planning agent are estimated unless probable
+constexpr auto ESTIMATE_PROBABILITY = 0.5f;		// Probability from which estimated goals are searched
+constexpr auto MULTI_TARGET_SEARCH = false;	// Goals of the same agents and handoff agent share one search
+
+Planner_Mac::Planner_Mac(Environment environment, Agent_Id planning_agent, const State& initial_state, size_t seed,
+	size_t max_coalition_size, size_t time_budget)
+	: Planner_Impl(environment, planning_agent), reachability(environment, initial_state, max_coalition_size),
+	time_step(0), plan_cache(), planned_steps(0), skipped_steps(0), max_coalition_size(max_coalition_size),
+	agent_combinations(get_combinations(environment.get_number_of_agents(), max_coalition_size)),
+	time_budget(time_budget), deadline(), goal_registry(std::make_shared<Goal_Registry>(environment)),
+	previous_lengths(goal_registry->size(), EMPTY_VAL), estimated_lengths(goal_registry->size(), EMPTY_VAL),
 	search(std::make_unique<A_Star>(environment, INITIAL_DEPTH_LIMIT)),
-	recogniser(std::make_unique<Sliding_Recogniser>(environment, initial_state)) {
+	recogniser(std::make_unique<Sliding_Recogniser>(environment, initial_state, goal_registry, max_coalition_size)) {
 	set_random_seed(seed);
-	initialize_reachables(initial_state);
 }
 
 Action Planner_Mac::get_next_action(const State& state, bool print_state) {
@@ -34,7 +44,18 @@ Action Planner_Mac::get_next_action(const State& state, bool print_state) {
 	if (print_state) environment.print_state(state);
 	PRINT(Print_Category::PLANNER, Print_Level::DEBUG, std::string("Time step: ") + std::to_string(time_step) + "\n");
 
-	initialize_reachables(state);
+	if (PLAN_REUSE && plan_cache.is_followed(state)) {
+		return get_planned_action(state);
+	}
+	plan_cache.clear();
+	++planned_steps;
+
+	if (time_budget != 0) {
+		deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(time_budget);
+		search.set_deadline(deadline);
+	}
+
+	reachability.update(state);
 	auto recipes = environment.get_possible_recipes(state);
 	if (recipes.empty()) {
 		return { Direction::NONE, { planning_agent } };
@@ -57,7 +78,10 @@ Action Planner_Mac::get_next_action(const State& state, bool print_state) {
 	if (info.has_value()
 		&& info.chosen_goal.has_value()
 		&& info.next_action.is_not_none()) {
-		result_action = get_random_good_action(info, paths, state);
+		result_action = is_deadline_passed() ? info.next_action : get_random_good_action(info, paths, state);
+		if (PLAN_REUSE) {
+			store_plan(info, paths, state, result_action);
+		}
 	}
 
 	std::stringstream stringstream;
@@ -74,6 +98,88 @@ Action Planner_Mac::get_next_action(const State& state, bool print_state) {
 	}
 }
 
+// Continue the cached plan without searching, the recogniser is updated from the progress along the cached paths
+Action Planner_Mac::get_planned_action(const State& state) {
+	const auto& performed_action = plan_cache.joint_actions.at(plan_cache.next_index - 1);
+
+	// Goals progress if their agents performed the next action of the goal path, otherwise length is kept
+	std::vector<size_t> goal_lengths(goal_registry->size(), EMPTY_VAL);
+	for (auto& [id, progress] : plan_cache.goal_progress) {
+		const auto& goal = goal_registry->get_goal(id);
+		if (progress.index < progress.joint_actions.size()) {
+			const auto& expected_action = progress.joint_actions.at(progress.index);
+			bool is_progress = true;
+			for (const auto& agent : goal.agents) {
+				if (expected_action.get_action(agent).direction != performed_action.get_action(agent).direction) {
+					is_progress = false;
+					break;
+				}
+			}
+			if (is_progress) {
+				++progress.index;
+				--progress.length;
+			}
+		}
+		goal_lengths.at(id) = progress.length;
+	}
+	recogniser.update(goal_lengths, state);
+
+	auto result_action = plan_cache.joint_actions.at(plan_cache.next_index).get_action(planning_agent);
+	++plan_cache.next_index;
+	++time_step;
+	++skipped_steps;
+
+	std::stringstream buffer;
+	buffer << "Agent " << planning_agent.id << " followed plan action " << result_action.to_string()
+		<< ", skipped " << skipped_steps << "/" << (skipped_steps + planned_steps) << " time steps\n";
+	PRINT(Print_Category::PLANNER, Print_Level::DEBUG, buffer.str());
+	return result_action;
+}
+
+void Planner_Mac::store_plan(const Collaboration_Info& info, const Paths& paths, const State& state, const Action& action) {
+	if (!info.get_agents().contains(planning_agent)) {
+		return;
+	}
+
+	auto [coalition_actions, goal_agents] = get_actions_from_permutation(info.get_goals(), paths, state);
+	if (coalition_actions.empty() || coalition_actions.at(0).get_action(planning_agent) != action) {
+		return;
+	}
+
+	// Agents outside the coalition are expected to stand still
+	std::vector<Agent_Id> all_agents;
+	for (size_t agent = 0; agent < environment.get_number_of_agents(); ++agent) {
+		all_agents.push_back({ agent });
+	}
+
+	// Keep the prefix of the plan which can be performed without conflicts and without waiting
+	auto predicted_state = state;
+	for (const auto& coalition_action : coalition_actions) {
+		if (coalition_action.get_action(planning_agent).is_none()) {
+			break;
+		}
+		Joint_Action joint_action{ Agent_Combination{ all_agents } };
+		for (const auto& single_action : coalition_action.actions) {
+			joint_action.update_action(single_action.agent, single_action.direction);
+		}
+		if (!environment.act(predicted_state, joint_action)) {
+			break;
+		}
+		plan_cache.joint_actions.push_back(joint_action);
+		plan_cache.predicted_states.push_back(predicted_state);
+	}
+	if (plan_cache.joint_actions.size() < 2) {
+		plan_cache.clear();
+		return;
+	}
+
+	for (auto id : paths.get_goal_ids()) {
+		const auto& path = paths.get_path(id);
+		plan_cache.goal_progress.push_back({ id, { path->joint_actions, 0, path->size() } });
+	}
+	plan_cache.next_index = 1;
+}
+
 Action Planner_Mac::get_random_good_action(const Collaboration_Info& info, const Paths& paths_in, const State& state) {
 
 	auto& goals = info.get_goals();
@@ -87,6 +193,9 @@ Action Planner_Mac::get_random_good_action(const Collaboration_Info& info, const
 		if (action.is_none()) {
 			continue;
 		}
+		if (is_deadline_passed()) {
+			break;
+		}
 		auto paths = perform_new_search(state, info.chosen_goal, paths_in, {}, {}, action);
 		if (paths.empty()) {
 			continue;
@@ -180,6 +289,11 @@ Action Planner_Mac::get_random_good_action(const Collaboration_Info& info, const
 		}
 	}
 
+	// Out of time before any alternative was evaluated
+	if (result_actions.empty()) {
+		return info.next_action;
+	}
+
 	auto result_action = get_random<Action>(result_actions);
 	if (result_action != info.next_action) {
 		std::stringstream buffer;
@@ -196,14 +310,14 @@ std::vector<Collaboration_Info> Planner_Mac::calculate_infos(const Paths& paths,
 	// Precalculate all recipe combinations
 	std::vector<std::vector<std::vector<Recipe>>> all_recipe_combinations;
 	size_t recipe_in_size = recipes_in.size();
-	for (size_t i = 0; i < total_agents && i < recipe_in_size; ++i) {
+	for (size_t i = 0; i < total_agents && i < max_coalition_size && i < recipe_in_size; ++i) {
 		all_recipe_combinations.push_back(get_combinations(recipes_in, i + 1));
 	}
 
-	auto agent_permutations = get_handoff_permutations();
 	std::vector<Collaboration_Info> infos;
+	size_t total_goals = 0;
+	size_t evaluated_goals = 0;
 
-	auto agent_combinations = get_combinations(total_agents);
 	for (const auto& agents : agent_combinations) {
 		size_t agent_size = agents.size();
 
@@ -227,66 +341,30 @@ std::vector<Collaboration_Info> Planner_Mac::calculate_infos(const Paths& paths,
 					}
 				}
 				else {
+					++total_goals;
+					if (is_deadline_passed()) {
+						continue;
+					}
+					++evaluated_goals;
+
 					Goals goals;
 					for (const auto& recipe : recipes) {
 						goals.add({ agents, recipe, EMPTY_VAL });
 					}
 
-					auto temp_infos = get_collaboration_permutations(goals, paths, agent_permutations.get(recipes.size()), state);
+					auto temp_infos = get_collaboration_permutations(goals, paths, state);
 					infos.insert(std::end(infos), std::begin(temp_infos), std::end(temp_infos));
 				}
 			}
 		}
 	}
-	return infos;
-}
-
-Permutations Planner_Mac::get_handoff_permutations() const {
-	// -1 for including none, 0 for not including none
-	int min_index = 0;
-	std::vector<Agent_Id> all_agents;
-	size_t max_size = environment.get_number_of_agents();
-	for (size_t i = 0; i < environment.get_number_of_agents(); ++i) {
-		all_agents.push_back({ i });
-	}
-
-	Permutations result(max_size);
-	size_t agent_size = all_agents.size();
-
-	// None-handoff for single agent
-	if (min_index > -1) {
-		result.insert(Agent_Combination(Agent_Id(EMPTY_VAL)));
-	}
-
-	for (size_t current_size = 1; current_size <= max_size; ++current_size) {
-		std::vector<int> counters(current_size, min_index);
-		bool done = false;
-		while (!done) {
-			std::vector<Agent_Id> next_permutation;
-			bool valid_permutation = true;
-			std::vector<bool> seen(agent_size, false);
-			for (size_t i = 0; i < counters.size(); i++) {
-				if (counters[i] == -1) {
-					next_permutation.push_back(Agent_Id(EMPTY_VAL));
-				}
-				else {
-					seen.at(counters[i]) = true;
-					next_permutation.push_back(all_agents.at(counters[i]));
-				}
-			}
-			if (valid_permutation) {
-				result.insert(next_permutation);
-			}
 
-			// Advance indices
-			size_t index = 0;
-			while (!done && ++counters.at(index) >= agent_size) {
-				counters.at(index++) = min_index;
-				done = index >= counters.size();
-			}
-		}
+	if (deadline.has_value()) {
+		std::stringstream buffer;
+		buffer << "Evaluated " << evaluated_goals << "/" << total_goals << " collaborations within time budget\n";
+		PRINT(Print_Category::PLANNER, Print_Level::DEBUG, buffer.str());
 	}
-	return result;
+	return infos;
 }
 
 std::vector<Collaboration_Info> Planner_Mac::calculate_probable_multi_goals(const std::vector<Collaboration_Info>& infos,
@@ -327,6 +405,7 @@ std::vector<Collaboration_Info> Planner_Mac::calculate_probable_multi_goals(cons
 	}
 
 	// Check if recipes are probable normalised on available tasks
+	auto normalisers = recogniser.get_normalisers(normalisation_goals);
 	for (size_t i = 0; i < infos.size(); ++i) {
 		const auto& info_entry = infos.at(i);
 		std::vector<bool>::reference is_probable = are_probable.at(i);
@@ -338,7 +417,7 @@ std::vector<Collaboration_Info> Planner_Mac::calculate_probable_multi_goals(cons
 			for (const auto& goal : info_entry.get_goals_iterable()) {
 				for (const auto& agent : goal.agents) {
 					bool use_non_probability = (agent != planning_agent || info_entry.goals_size() > 1);
-					if (recogniser.is_probable_normalised(goal, normalisation_goals, agent, planning_agent, use_non_probability)) {
+					if (recogniser.is_probable_normalised(goal, normalisers, agent, planning_agent, use_non_probability)) {
 						inner_probable = true;
 						break;
 					}
@@ -405,6 +484,12 @@ std::map<Goals, float> Planner_Mac::calculate_goal_values(std::vector<Collaborat
 constexpr size_t action_trace_length = 3;
 bool Planner_Mac::is_conflict_in_permutation(const State& initial_state, const std::vector<Joint_Action>& actions) {
 
+	// Collisions between agents without simulating, only when the joint actions hold every agent
+	// in order, as the collision check pairs actions with agents by index
+	if (!actions.empty() && actions.front().actions.size() == environment.get_number_of_agents()
+		&& Reservation_Table(environment, initial_state, actions).has_conflict()) {
+		return true;
+	}
 
 	// Perform actions, check for invalid/collisions
 	auto state = initial_state;
@@ -665,127 +750,163 @@ struct Temp_Info {
 	}
 };
 
-// TODO - Would be best to return pointers, but paths is a local variable in one of the calls
-std::optional<std::vector<Action_Path>> Planner_Mac::get_permutation_action_paths(const Goals& goals,
+// Shared, so the paths stay valid after a local Paths is destroyed
+std::optional<std::vector<Paths::Path_Ptr>> Planner_Mac::get_permutation_action_paths(const Goals& goals,
 	const Paths& paths) const {
 
-	std::vector<Action_Path> action_paths;
+	std::vector<Paths::Path_Ptr> action_paths;
 	for (const auto& goal : goals.get_iterable()) {
-		auto info_opt = paths.get_handoff(goal);
-		if (info_opt.has_value()) {
-			action_paths.push_back(*info_opt.value());
-		}
-		else {
+		const auto& path = paths.get_shared_path(goal_registry->get_id(goal));
+		if (path == nullptr) {
 			return {};
 		}
+		action_paths.push_back(path);
 	}
 	return action_paths;
 }
 
-std::vector<Collaboration_Info> Planner_Mac::get_collaboration_permutations(const Goals& goals_in,
-	const Paths& paths, const std::vector<Agent_Combination>& agent_permutations,
-	const State& state) {
-
-	std::vector<Collaboration_Info> infos;
-
-	// Get info on each permutation
-	for (const auto& agent_permutation : agent_permutations) {
-		if (goals_in.get_agents().size() == 1) {
-			if (agent_permutation != Agent_Combination(Agent_Id(EMPTY_VAL))) {
-				continue;
+// Enumerate handoff agents per goal with branch and bound. The permutation length is at least the longest
+// path of its goals, so subtrees whose bound exceeds the best length found so far are skipped.
+std::vector<Collaboration_Info> Planner_Mac::get_collaboration_permutations(const Goals& goals,
+	const Paths& paths, const State& state) {
+
+	const auto& agents = goals.get_agents();
+	size_t goals_size = goals.size();
+
+	// Path lengths per goal and handoff agent, EMPTY_VAL if no path
+	std::vector<std::vector<size_t>> path_lengths(goals_size, std::vector<size_t>(agents.size(), EMPTY_VAL));
+	std::vector<size_t> min_lengths(goals_size, EMPTY_VAL);
+	for (size_t goal_index = 0; goal_index < goals_size; ++goal_index) {
+		auto goal = goals.get_iterable().at(goal_index);
+		for (size_t agent_index = 0; agent_index < agents.size(); ++agent_index) {
+			goal.handoff_agent = agents.get(agent_index);
+			auto path = paths.get_handoff(goal);
+			if (path.has_value()) {
+				path_lengths.at(goal_index).at(agent_index) = path.value()->size();
+				min_lengths.at(goal_index) = std::min(min_lengths.at(goal_index), path.value()->size());
 			}
 		}
-		else {
-			bool invalid_agent = false;
-			for (const auto& agent : agent_permutation) {
-				if (
-					// If we allow none-handoff agents
-					!goals_in.get_agents().contains(agent)) {
 
-					invalid_agent = true;
-					break;
-				}
-			}
-			if (invalid_agent) {
-				continue;
-			}
+		// No handoff agent can solve the goal
+		if (min_lengths.at(goal_index) == EMPTY_VAL) {
+			return {};
 		}
+	}
+
+	// Bound for the goals which are not yet assigned, goals are assigned from the last to the first
+	std::vector<size_t> remaining_bounds(goals_size, 0);
+	for (size_t goal_index = 1; goal_index < goals_size; ++goal_index) {
+		remaining_bounds.at(goal_index) = std::max(remaining_bounds.at(goal_index - 1), min_lengths.at(goal_index - 1));
+	}
 
+	std::vector<Collaboration_Info> infos;
+	std::vector<Agent_Id> handoff_agents(goals_size, EMPTY_VAL);
+	size_t best_length = HIGH_INIT_VAL;
+	get_collaboration_permutations_inner(goals, paths, state, path_lengths, remaining_bounds,
+		handoff_agents, goals_size, 0, best_length, infos);
+	return infos;
+}
+
+void Planner_Mac::get_collaboration_permutations_inner(const Goals& goals_in, const Paths& paths,
+	const State& state, const std::vector<std::vector<size_t>>& path_lengths,
+	const std::vector<size_t>& remaining_bounds, std::vector<Agent_Id>& handoff_agents, size_t goal_index,
+	size_t bound, size_t& best_length, std::vector<Collaboration_Info>& infos) {
+
+	if (goal_index == 0) {
 		auto goals = goals_in;
-		goals.update_handoffs(agent_permutation);
+		goals.update_handoffs(Agent_Combination{ handoff_agents });
+		auto info = get_collaboration_info(goals, paths, state);
+		if (info.has_value()) {
+			best_length = std::min(best_length, info.length);
+			infos.push_back(info);
+		}
+		return;
+	}
 
-		size_t length = get_permutation_length(goals, paths);
+	--goal_index;
+	const auto& agents = goals_in.get_agents();
+	for (size_t agent_index = 0; agent_index < agents.size(); ++agent_index) {
+		auto length = path_lengths.at(goal_index).at(agent_index);
 		if (length == EMPTY_VAL) {
 			continue;
 		}
+		auto new_bound = std::max({ bound, length, remaining_bounds.at(goal_index) });
+		if (new_bound > best_length) {
+			continue;
+		}
+		handoff_agents.at(goal_index) = agents.get(agent_index);
+		get_collaboration_permutations_inner(goals_in, paths, state, path_lengths, remaining_bounds,
+			handoff_agents, goal_index, new_bound, best_length, infos);
+	}
+}
 
-		// Get conflict info
-		auto [original_joint_actions, goal_agents] = get_actions_from_permutation(goals, paths, state);
+Collaboration_Info Planner_Mac::get_collaboration_info(const Goals& goals, const Paths& paths, const State& state) {
+	size_t length = get_permutation_length(goals, paths);
+	if (length == EMPTY_VAL) {
+		return {};
+	}
 
-		if (is_conflict_in_permutation(state, original_joint_actions)) {
+	// Get conflict info
+	auto [original_joint_actions, goal_agents] = get_actions_from_permutation(goals, paths, state);
 
-			// Perform collision avoidance search
-			size_t best_length = HIGH_INIT_VAL;
-			Collaboration_Info best_collaboration;
-			for (const auto& goal : goals) {
+	if (is_conflict_in_permutation(state, original_joint_actions)) {
 
-				// Skip if no agent chose to act on this recipe
-				if (goal_agents.empty(goal)) {
-					continue;
-				}
+		// Perform collision avoidance search
+		size_t best_length = HIGH_INIT_VAL;
+		Collaboration_Info best_collaboration;
+		for (const auto& goal : goals) {
 
-				auto joint_actions = original_joint_actions;
-				trim_trailing_non_actions(joint_actions, goal.handoff_agent);
+			// Skip if no agent chose to act on this recipe
+			if (goal_agents.empty(goal)) {
+				continue;
+			}
 
-				// Perform new search for one recipe
-				auto new_paths = perform_new_search(state, goal, paths, joint_actions, goal_agents.get(goal));
-				if (new_paths.empty()) {
-					continue;
-				}
+			auto joint_actions = original_joint_actions;
+			trim_trailing_non_actions(joint_actions, goal.handoff_agent);
 
-				// Get info using the new search
-				size_t new_length = get_permutation_length(goals, new_paths);
+			// Perform new search for one recipe
+			auto new_paths = perform_new_search(state, goal, paths, joint_actions, goal_agents.get(goal));
+			if (new_paths.empty()) {
+				continue;
+			}
 
-				// Check if best collision avoidance search so far
-				// TODO - Not sure if should introduce randomness between equal choices of collision avoidance
-				if (new_length < best_length) {
-					auto [joint_actions, goal_agents] = get_actions_from_permutation(goals, new_paths, state);
+			// Get info using the new search
+			size_t new_length = get_permutation_length(goals, new_paths);
 
-					if (!is_conflict_in_permutation(state, joint_actions)) {
-						Action planning_agent_action{};
-						if (goals_in.get_agents().contains(planning_agent)) {
-							planning_agent_action = joint_actions.at(0).get_action(planning_agent);
-						}
-						best_length = new_length;
-						auto chosen_goal = goal_agents.get_chosen_goal();
-						size_t path_length = EMPTY_VAL;
-						if (chosen_goal.has_value()) {
-							path_length = paths.get_handoff(chosen_goal).value()->size();
-						}
-						best_collaboration = { new_length, goals, planning_agent_action, chosen_goal, path_length };
+			// Check if best collision avoidance search so far
+			// TODO - Not sure if should introduce randomness between equal choices of collision avoidance
+			if (new_length < best_length) {
+				auto [joint_actions, goal_agents] = get_actions_from_permutation(goals, new_paths, state);
+
+				if (!is_conflict_in_permutation(state, joint_actions)) {
+					Action planning_agent_action{};
+					if (goals.get_agents().contains(planning_agent)) {
+						planning_agent_action = joint_actions.at(0).get_action(planning_agent);
+					}
+					best_length = new_length;
+					auto chosen_goal = goal_agents.get_chosen_goal();
+					size_t path_length = EMPTY_VAL;
+					if (chosen_goal.has_value()) {
+						path_length = paths.get_handoff(chosen_goal).value()->size();
 					}
+					best_collaboration = { new_length, goals, planning_agent_action, chosen_goal, path_length };
 				}
 			}
-			if (best_length != HIGH_INIT_VAL) {
-				infos.push_back(best_collaboration);
-			}
-
-			// Return unmodified entry
 		}
-		else {
-			Action planning_agent_action{};
-			if (goals_in.get_agents().contains(planning_agent)) {
-				planning_agent_action = original_joint_actions.at(0).get_action(planning_agent);
-			}
-			auto chosen_goal = goal_agents.get_chosen_goal();
-			auto path_length = EMPTY_VAL;
-			if (chosen_goal.has_value()) {
-				path_length = paths.get_handoff(chosen_goal).value()->size();
-			}
-			infos.push_back(Collaboration_Info(length, goals, planning_agent_action, chosen_goal, path_length));
+		return best_collaboration;
+	}
+	else {
+		Action planning_agent_action{};
+		if (goals.get_agents().contains(planning_agent)) {
+			planning_agent_action = original_joint_actions.at(0).get_action(planning_agent);
+		}
+		auto chosen_goal = goal_agents.get_chosen_goal();
+		auto path_length = EMPTY_VAL;
+		if (chosen_goal.has_value()) {
+			path_length = paths.get_handoff(chosen_goal).value()->size();
 		}
+		return Collaboration_Info(length, goals, planning_agent_action, chosen_goal, path_length);
 	}
-	return infos;
 }
 
 Paths Planner_Mac::perform_new_search(const State& state, const Goal& goal, const Paths& paths,
@@ -794,7 +915,7 @@ Paths Planner_Mac::perform_new_search(const State& state, const Goal& goal, cons
 
 	auto new_path = search.search_joint(state, goal.recipe, goal.agents, goal.handoff_agent, joint_actions, acting_agents, initial_action);
 	if (new_path.empty()) {
-		return {};
+		return Paths(goal_registry);
 	}
 	Search_Trimmer trim;
 	trim.trim_forward(new_path, state, environment, goal.recipe);
@@ -908,9 +1029,7 @@ bool Planner_Mac::temp(const Agent_Combination& agents, const Agent_Id& handoff_
 }
 
 Paths Planner_Mac::get_all_paths(const std::vector<Recipe>& recipes, const State& state) {
-	Paths paths;
-	auto agent_combinations = get_combinations(environment.get_number_of_agents());
-
+	std::vector<Goal> goals;
 	auto recipe_size = recipes.size();
 	for (const auto& agents : agent_combinations) {
 		for (size_t i = 0; i < recipe_size; ++i) {
@@ -933,6 +1052,10 @@ Paths Planner_Mac::get_all_paths(const std::vector<Recipe>& recipes, const State
 				continue;
 			}
 
+			if (!is_coalition_local(agents, recipe, state)) {
+				continue;
+			}
+
 
 			Agent_Combination handoff_agents;
 			if (agents.size() > 1) {
@@ -963,113 +1086,168 @@ Paths Planner_Mac::get_all_paths(const std::vector<Recipe>& recipes, const State
 						continue;
 					}
 				}
+				goals.emplace_back(agents, recipe, handoff_agent);
+			}
+		}
+	}
 
-				auto time_start = std::chrono::system_clock::now();
-				auto path = search.search_joint(state, recipe, agents, handoff_agent, {}, {}, {});
-				auto time_end = std::chrono::system_clock::now();
-				auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(time_end - time_start).count();
-
-				Goal goal(agents, recipe, handoff_agent);
-				Action_Path a_path{ path, goal, state, environment };
-
+	// With a time budget the most relevant goals are searched first, i.e. the planning agent's own goals,
+	// then by recogniser probability and path length at the last time step
+	if (deadline.has_value()) {
+		std::vector<std::tuple<bool, float, size_t, size_t>> priorities;
+		for (size_t i = 0; i < goals.size(); ++i) {
+			const auto& goal = goals.at(i);
+			priorities.emplace_back(!goal.agents.is_only_agent(planning_agent), -recogniser.get_probability(goal),
+				previous_lengths.at(goal_registry->get_id(goal)), i);
+		}
+		std::sort(priorities.begin(), priorities.end());
+		std::vector<Goal> sorted_goals;
+		for (const auto& priority : priorities) {
+			sorted_goals.push_back(goals.at(std::get<3>(priority)));
+		}
+		goals = sorted_goals;
+	}
 
-				std::stringstream buffer;
-				buffer << agents.to_string() << "/"
-					<< handoff_agent.to_string() << " : "
-					<< a_path.size() << " ("
-					<< a_path.first_action_string() << "-"
-					<< a_path.last_action_string() << ") : "
-					<< recipe.result_char() << " : "
-					<< diff << std::endl;
-				PRINT(Print_Category::PLANNER, Print_Level::DEBUG, buffer.str());
+	Paths paths(goal_registry);
+	std::map<std::pair<Agent_Combination, Agent_Id>, std::map<Recipe, std::vector<Joint_Action>>> coalition_paths;
+	size_t searched_goals = 0;
+	std::fill(estimated_lengths.begin(), estimated_lengths.end(), EMPTY_VAL);
+	for (const auto& goal : goals) {
+		if (is_deadline_passed()) {
+			break;
+		}
 
-				if (!path.empty()) {
+		// The recogniser only needs lengths for goals of the other agents, an admissible estimate
+		// suffices until the goal becomes probable
+		if (RECOGNISER_ESTIMATES && !goal.agents.contains(planning_agent)
+			&& recogniser.get_probability(goal) < ESTIMATE_PROBABILITY) {
 
-					Search_Trimmer trim;
-					trim.trim_forward(path, state, environment, recipe);
-					paths.insert(path, goal, state, environment);
+			auto estimate = search.estimate_length(state, goal.recipe, goal.agents, goal.handoff_agent);
+			if (estimate != EMPTY_VAL) {
+				estimated_lengths.at(goal_registry->get_id(goal)) = estimate;
+				continue;
+			}
+		}
+		++searched_goals;
+
+		auto time_start = std::chrono::system_clock::now();
+		std::vector<Joint_Action> path;
+		if (MULTI_TARGET_SEARCH) {
+
+			// Searched with the first goal of the agents, also for goals which are estimated later on
+			auto key = std::make_pair(goal.agents, goal.handoff_agent);
+			auto coalition_it = coalition_paths.find(key);
+			if (coalition_it == coalition_paths.end()) {
+				std::vector<Recipe> coalition_recipes;
+				for (const auto& other_goal : goals) {
+					if (other_goal.agents == goal.agents && other_goal.handoff_agent == goal.handoff_agent) {
+						coalition_recipes.push_back(other_goal.recipe);
+					}
 				}
+				auto coalition_search = search.search_joint_multi(state, coalition_recipes, goal.agents, goal.handoff_agent);
+				coalition_it = coalition_paths.emplace(key, std::move(coalition_search)).first;
+			}
+			auto path_it = coalition_it->second.find(goal.recipe);
+			if (path_it != coalition_it->second.end()) {
+				path = path_it->second;
 			}
 		}
+		else {
+			path = search.search_joint(state, goal.recipe, goal.agents, goal.handoff_agent, {}, {}, {});
+		}
+		auto time_end = std::chrono::system_clock::now();
+		auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(time_end - time_start).count();
+
+		Action_Path a_path{ path, goal, state, environment };
+
+
+		std::stringstream buffer;
+		buffer << goal.agents.to_string() << "/"
+			<< goal.handoff_agent.to_string() << " : "
+			<< a_path.size() << " ("
+			<< a_path.first_action_string() << "-"
+			<< a_path.last_action_string() << ") : "
+			<< goal.recipe.result_char() << " : "
+			<< diff << std::endl;
+		PRINT(Print_Category::PLANNER, Print_Level::DEBUG, buffer.str());
+
+		if (!path.empty()) {
+
+			Search_Trimmer trim;
+			trim.trim_forward(path, state, environment, goal.recipe);
+			paths.insert(path, goal, state, environment);
+			previous_lengths.at(goal_registry->get_id(goal)) = path.size();
+		}
+		else if (!is_deadline_passed()) {
+			previous_lengths.at(goal_registry->get_id(goal)) = EMPTY_VAL;
+		}
+	}
+
+	if (deadline.has_value()) {
+		std::stringstream buffer;
+		buffer << "Searched " << searched_goals << "/" << goals.size() << " goals within time budget\n";
+		PRINT(Print_Category::PLANNER, Print_Level::DEBUG, buffer.str());
 	}
 	return paths;
 }
 
 void Planner_Mac::update_recogniser(const Paths& paths, const State& state) {
-	std::map<Goal, size_t> goal_lengths;
-	for (const auto& [goal, path] : paths.get_handoff()) {
-		goal_lengths.insert({ goal, path->size() });
+	auto goal_lengths = estimated_lengths;
+	for (auto id : paths.get_goal_ids()) {
+		goal_lengths.at(id) = paths.get_path(id)->size();
 	}
 	recogniser.update(goal_lengths, state);
 }
+// Limit coalitions when the coalition size is bounded, every agent must be able to reach an ingredient
+// of the recipe or share reachable cells with another agent in the coalition
+bool Planner_Mac::is_coalition_local(const Agent_Combination& agents, const Recipe& recipe, const State& state) const {
+	if (max_coalition_size >= environment.get_number_of_agents() || agents.size() == 1) {
+		return true;
+	}
+
+	for (const auto& agent : agents) {
+		auto reduced_agents = agents;
+		reduced_agents.remove(agent);
+		if (ingredient_reachable(recipe.ingredient1, agent, reduced_agents, state)
+			|| ingredient_reachable(recipe.ingredient2, agent, reduced_agents, state)) {
+			continue;
+		}
+
+		bool is_overlapping = false;
+		for (const auto& other_agent : reduced_agents) {
+			auto other_reduced_agents = agents;
+			other_reduced_agents.remove(other_agent);
+			if (reachability.is_overlapping(agent, reduced_agents, other_agent, other_reduced_agents)) {
+				is_overlapping = true;
+				break;
+			}
+		}
+		if (!is_overlapping) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Planner_Mac::is_deadline_passed() const {
+	return deadline.has_value() && std::chrono::steady_clock::now() >= deadline.value();
+}
+
 bool Planner_Mac::ingredients_reachable(const Recipe& recipe, const Agent_Id agent, const Agent_Combination& agents, const State& state) const {
 	if (!ingredient_reachable(recipe.ingredient1, agent, agents, state)) return false;
 	return ingredient_reachable(recipe.ingredient2, agent, agents, state);
 }
 
 bool Planner_Mac::ingredient_reachable(const Ingredient& ingredient_in, const Agent_Id agent, const Agent_Combination& agents, const State& state) const {
-	auto reachables = agent_reachables.find({ agent, agents });
-	if (reachables == agent_reachables.end()) {
-		throw std::runtime_error("Unknown agent combination");
-
-	}
-
 	const auto& agent_item = state.get_agent(agent).item;
 	if (agent_item.has_value() && agent_item.value() == ingredient_in) {
 		return true;
 	}
 
 	for (const auto& location : environment.get_coordinates(state, ingredient_in, false)) {
-		if (reachables->second.get(location)) {
+		if (reachability.is_reachable(agent, agents, location)) {
 			return true;
 		}
 	}
 	return false;
 }
-
-
-void Planner_Mac::initialize_reachables(const State& state) {
-	agent_reachables.clear();
-	std::vector<size_t> all_agents;
-	for (size_t i = 0; i < state.agents.size(); ++i) {
-		all_agents.push_back(i);
-	}
-
-	for (size_t agent = 0; agent < state.agents.size(); ++agent) {
-		auto reduced_agents = all_agents;
-		reduced_agents.erase(reduced_agents.begin() + agent);
-
-		auto combinations = get_combinations(reduced_agents);
-		combinations.push_back({});
-		for (const auto& agents : combinations) {
-			Reachables reachables(environment.get_width(), environment.get_height());
-
-			// Initial agent locations
-			std::deque<Coordinate> frontier;
-			auto location = state.get_location(agent);
-			reachables.set(location, true);
-			frontier.push_back(location);
-
-			// BFS search
-			while (!frontier.empty()) {
-				auto next = frontier.front();
-				frontier.pop_front();
-
-				for (const auto& location : environment.get_neighbours(next)) {
-					if (!reachables.get(location)) {
-						reachables.set(location, true);
-						auto blocking_agent = state.get_agent(location);
-
-						if (!environment.is_cell_type(location, Cell_Type::WALL)
-							&& (!blocking_agent.has_value()
-								|| agents.contains(blocking_agent.value())
-								|| agent == blocking_agent.value().id)) {
-							frontier.push_back(location);
-						}
-					}
-				}
-			}
-			agent_reachables.insert({ {agent, agents}, reachables });
-		}
-	}
-}
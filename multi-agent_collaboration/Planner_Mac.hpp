@@ -2,88 +2,69 @@
 
 #include "Environment.hpp"
 #include "Core.hpp"
+#include "Goal_Registry.hpp"
 #include "Search.hpp"
 #include "State.hpp"
 #include "Recogniser.hpp"
 #include "Planner.hpp"
+#include "Reachability.hpp"
 
+#include <chrono>
 #include <vector>
 #include <set>
 #include <deque>
+#include <memory>
 
 struct Action_Path {
-	Action_Path(std::vector<Joint_Action> joint_actions,
+	Action_Path(std::vector<Joint_Action> joint_actions_in,
 		const Goal goal,
 		const State& state_in,
 		const Environment& environment)
-		: joint_actions(joint_actions), recipe(goal.recipe), agents(goal.agents),
-		handoff_agent(goal.handoff_agent),
-		first_action(EMPTY_VAL), last_action(EMPTY_VAL) {
+		: joint_actions(std::move(joint_actions_in)), recipe(goal.recipe), agents(goal.agents),
+		first_action(EMPTY_VAL), last_action(EMPTY_VAL), handoff_agent(goal.handoff_agent),
+		start_coordinates(), first_non_trivial(state_in.agents.size(), EMPTY_VAL),
+		has_interaction(state_in.agents.size(), false) {
 
-		if (joint_actions.empty() || handoff_agent == EMPTY_VAL) {
-			return;
+		for (const auto& agent : state_in.agents) {
+			start_coordinates.push_back(agent.coordinate);
 		}
-		auto initial_coordinate = state_in.get_agent(handoff_agent).coordinate;
-
-		// Stop at first action which interacts with a wall
-		first_action = 0;
-		auto coordinate = initial_coordinate;
-		while (true) {
-			auto direction = joint_actions.at(first_action).get_action(handoff_agent).direction;
-			auto coordinate_noclip = environment.move_noclip(coordinate, direction);
-
-			// New useful definition
-			if (environment.is_cell_type(coordinate_noclip, Cell_Type::WALL)) {
-				auto item = state_in.get_ingredient_at_position(coordinate_noclip);
-				auto agent_item = state_in.get_agent(handoff_agent).item;
-				if (item.has_value()
-					&& (item.value() == goal.recipe.ingredient1
-						|| item.value() == goal.recipe.ingredient2)) {
-					break;
-				}
-				else if (agent_item.has_value()
-					&& (agent_item.value() == goal.recipe.ingredient1
-						|| agent_item.value() == goal.recipe.ingredient2)) {
-					break;
-				}
-			}
 
-			if (first_action == joint_actions.size() - 1) {
-				first_action = EMPTY_VAL;
-				break;
-			}
-			++first_action;
-			coordinate = environment.move(coordinate, direction);
+		// Useful handoff actions interact with a wall holding a recipe ingredient in state_in, or while the
+		// handoff agent held one in state_in. The actions are not performed, only the agent coordinates are
+		// tracked (note wall check is using noclip, but coordinate tracking is using regular move)
+		bool is_holding_ingredient = false;
+		if (handoff_agent != EMPTY_VAL) {
+			auto agent_item = state_in.get_agent(handoff_agent).item;
+			is_holding_ingredient = agent_item.has_value()
+				&& (agent_item.value() == recipe.ingredient1
+					|| agent_item.value() == recipe.ingredient2);
 		}
 
-		// Note last action which interacts with a wall 
-		// (note wall check is using noclip, but coordinate tracking is using regular move)
-		coordinate = initial_coordinate;
-		last_action = EMPTY_VAL;
-		size_t action_counter = 0;
-		auto state = state_in;
-		while (action_counter < joint_actions.size()) {
-			assert(environment.act(state, joint_actions.at(action_counter)));
-			const auto& direction = joint_actions.at(action_counter).get_action(handoff_agent).direction;
-
-			// New useful definition
-			if (environment.is_cell_type(environment.move_noclip(coordinate, direction), Cell_Type::WALL)) {
-				auto item = state.get_ingredient_at_position(environment.move_noclip(coordinate, direction));
-				auto agent_item = state.get_agent(handoff_agent).item;
-				if (item.has_value()
-					&& (item.value() == goal.recipe.ingredient1
-						|| item.value() == goal.recipe.ingredient2)) {
-					last_action = action_counter;
+		auto coordinates = start_coordinates;
+		for (size_t index = 0; index < joint_actions.size(); ++index) {
+			for (const auto& action : joint_actions.at(index).actions) {
+				auto agent = action.agent.id;
+				if (action.is_not_none() && first_non_trivial.at(agent) == EMPTY_VAL) {
+					first_non_trivial.at(agent) = index;
 				}
-				else if (agent_item.has_value()
-					&& (agent_item.value() == goal.recipe.ingredient1
-						|| agent_item.value() == goal.recipe.ingredient2)) {
-					last_action = action_counter;;
+
+				auto coordinate_noclip = environment.move_noclip(coordinates.at(agent), action.direction);
+				if (environment.is_cell_type(coordinate_noclip, Cell_Type::WALL)) {
+					has_interaction.at(agent) = true;
+
+					if (action.agent == handoff_agent) {
+						auto item = state_in.get_ingredient_at_position(coordinate_noclip);
+						if (is_holding_ingredient
+							|| (item.has_value()
+								&& (item.value() == recipe.ingredient1
+									|| item.value() == recipe.ingredient2))) {
+							first_action = std::min(first_action, index);
+							last_action = index;
+						}
+					}
 				}
+				coordinates.at(agent) = environment.move(coordinates.at(agent), action.direction);
 			}
-
-			coordinate = environment.move(coordinate, direction);
-			++action_counter;
 		}
 	}
 
@@ -110,9 +91,13 @@ struct Action_Path {
 		return last_action != EMPTY_VAL;
 	}
 
+	// Whether the agent interacts with a wall, answered from the construction when starting from the same cell
 	bool has_useful_action(const Agent_Id& agent, const State& state, const Environment& environment) const {
 
 		auto coordinate = state.get_agent(agent).coordinate;
+		if (agent.id < start_coordinates.size() && coordinate == start_coordinates.at(agent.id)) {
+			return has_interaction.at(agent.id);
+		}
 		size_t action_counter = 0;
 		while (action_counter < joint_actions.size()) {
 			coordinate = environment.move_noclip(coordinate, joint_actions.at(action_counter).get_action(agent).direction);
@@ -125,14 +110,7 @@ struct Action_Path {
 	}
 
 	size_t get_first_non_trivial_index(Agent_Id agent) const {
-		size_t index = 0;
-		for (const auto& action : joint_actions) {
-			if (action.is_not_none(agent)) {
-				return index;
-			}
-			++index;
-		}
-		return EMPTY_VAL;
+		return agent.id < first_non_trivial.size() ? first_non_trivial.at(agent.id) : EMPTY_VAL;
 	}
 
 	Action get_next_action(Agent_Id agent) const {
@@ -155,64 +133,119 @@ struct Action_Path {
 	size_t last_action;		// Last useful action by handoff_agent
 
 	Agent_Id handoff_agent;
+
+private:
+	std::vector<Coordinate> start_coordinates;	// Agent coordinates in the state the path was found from
+	std::vector<size_t> first_non_trivial;		// By agent, first action which is not none
+	std::vector<bool> has_interaction;			// By agent, whether any action moves into a wall
 };
 
+// Paths by goal id, goal ids are kept sorted so iteration follows the Goal order
+// Paths are immutable and shared, so copying Paths copies no path. A copy also shares the table of
+// its source, and keeps replaced paths in an overlay until it inserts a goal without a path.
+// A re-search of one goal then copies and updates Paths independent of the number of goals.
 struct Paths {
-	Paths() : handoff_map(), handoff_paths() {}
+	using Path_Ptr = std::shared_ptr<const Action_Path>;
 
-	Paths(const Paths& other) {
-		for (const auto& [goal, path_ptr] : other.handoff_map) {
-			this->insert(goal, *path_ptr);
-		}
-	}
+	Paths(std::shared_ptr<const Goal_Registry> goal_registry)
+		: goal_registry(goal_registry), table(std::make_shared<Path_Table>(goal_registry->size())), overlay() {}
 
 	void insert(const Goal& goal, const Action_Path& path) {
-		handoff_paths.push_back(path);
-		handoff_map.insert({ goal, &handoff_paths.back() });
+		insert(goal_registry->get_id(goal), std::make_shared<const Action_Path>(path));
 	}
 
 	void insert(const std::vector<Joint_Action>& actions, const Goal& goal,
 		const State& state, const Environment& environment) {
 
-		handoff_paths.push_back({ actions, goal, state, environment });
-		Action_Path* path_ptr = &handoff_paths.back();
-		handoff_map.insert({ goal, path_ptr });
-
+		insert(goal_registry->get_id(goal), std::make_shared<const Action_Path>(actions, goal, state, environment));
 	}
 
 	void update(const std::vector<Joint_Action>& actions,
 		const Goal& goal, const State& state, const Environment& environment) {
 
-		auto it = handoff_map.find(goal);
-		if (it == handoff_map.end()) {
-			insert(actions, goal, state, environment);
+		auto id = goal_registry->get_id(goal);
+		auto path = std::make_shared<const Action_Path>(actions, goal, state, environment);
+		if (table->paths.at(id) == nullptr) {
+			insert(id, path);
+			return;
+		}
+		for (auto& [overlay_id, overlay_path] : overlay) {
+			if (overlay_id == id) {
+				overlay_path = path;
+				return;
+			}
+		}
+		if (table.use_count() == 1) {
+			table->paths.at(id) = path;
 		}
 		else {
-			(*it->second) = Action_Path(actions, goal, state, environment);
+			overlay.emplace_back(id, path);
 		}
 	}
 
-	const std::map<Goal, Action_Path*>& get_handoff() const {
-		return handoff_map;
+	const std::vector<size_t>& get_goal_ids() const {
+		return table->goal_ids;
+	}
+
+	const Goal& get_goal(size_t id) const {
+		return goal_registry->get_goal(id);
+	}
+
+	const Action_Path* get_path(size_t id) const {
+		return get_shared_path(id).get();
+	}
+
+	// Keeps the path alive independent of this
+	const Path_Ptr& get_shared_path(size_t id) const {
+		for (const auto& [overlay_id, overlay_path] : overlay) {
+			if (overlay_id == id) {
+				return overlay_path;
+			}
+		}
+		return table->paths.at(id);
 	}
 
 	std::optional<const Action_Path*> get_handoff(const Goal& goal) const {
-		auto it = handoff_map.find(goal);
-		if (it == handoff_map.end()) {
+		auto path_ptr = get_path(goal_registry->get_id(goal));
+		if (path_ptr == nullptr) {
 			return {};
 		}
 		else {
-			return it->second;
+			return path_ptr;
 		}
 	}
 
 	bool empty() const {
-		return handoff_paths.empty();
+		return table->goal_ids.empty();
 	}
 
 private:
-	std::deque<Action_Path> handoff_paths;
-	std::map<Goal, Action_Path*> handoff_map;
+	struct Path_Table {
+		Path_Table(size_t size) : paths(size, nullptr), goal_ids() {}
+		std::vector<Path_Ptr> paths;	// Indexed by goal id, nullptr without path
+		std::vector<size_t> goal_ids;	// Sorted ids of the goals with paths
+	};
+
+	// The first path of a goal is kept
+	void insert(size_t id, Path_Ptr path) {
+		if (table->paths.at(id) != nullptr) {
+			return;
+		}
+		if (table.use_count() != 1) {
+			table = std::make_shared<Path_Table>(*table);
+		}
+		for (const auto& [overlay_id, overlay_path] : overlay) {
+			table->paths.at(overlay_id) = overlay_path;
+		}
+		overlay.clear();
+
+		table->goal_ids.insert(std::lower_bound(table->goal_ids.begin(), table->goal_ids.end(), id), id);
+		table->paths.at(id) = std::move(path);
+	}
+
+	std::shared_ptr<const Goal_Registry> goal_registry;
+	std::shared_ptr<Path_Table> table;				// Shared with copies, written only when not shared
+	std::vector<std::pair<size_t, Path_Ptr>> overlay;	// Replaced paths of goals in a shared table
 };
 
 struct Permutations {
@@ -341,18 +374,19 @@ struct Solution_History {
 	}
 };
 
+// Agents acting towards each goal, at most one goal per agent so the entries are searched linearly
 struct Goal_Agents {
 	Agent_Combination get(Goal goal) {
-		return data[goal];
+		return at(goal);
 	}
 	void add(Goal goal, Agent_Combination agents) {
-		data[goal].add(agents);
+		at(goal).add(agents);
 	}
 	void add(Goal goal, Agent_Id agent) {
-		data[goal].add(agent);
+		at(goal).add(agent);
 	}
 	bool empty(Goal goal) const {
-		return data.find(goal) == data.end();
+		return std::none_of(data.begin(), data.end(), [&goal](const auto& entry) { return entry.first == goal; });
 	}
 	void set_chosen_goal(Goal goal) {
 		chosen_goal = goal;
@@ -360,15 +394,57 @@ struct Goal_Agents {
 	Goal get_chosen_goal() {
 		return chosen_goal;
 	}
-	std::map<Goal, Agent_Combination> data;
+	Agent_Combination& at(const Goal& goal) {
+		for (auto& [entry_goal, agents] : data) {
+			if (entry_goal == goal) {
+				return agents;
+			}
+		}
+		return data.emplace_back(goal, Agent_Combination{}).second;
+	}
+	std::vector<std::pair<Goal, Agent_Combination>> data;
 	Goal chosen_goal;
 };
 
+// Progress of the other agents along a goal path from the last full planning step
+struct Goal_Progress {
+	std::vector<Joint_Action> joint_actions;
+	size_t index;	// Next expected joint action
+	size_t length;	// Remaining length reported to the recogniser
+};
+
+// Joint plan from the last full planning step, reused as long as the state evolves as predicted
+struct Plan_Cache {
+	Plan_Cache() : joint_actions(), predicted_states(), goal_progress(), next_index(EMPTY_VAL) {}
+
+	void clear() {
+		joint_actions.clear();
+		predicted_states.clear();
+		goal_progress.clear();
+		next_index = EMPTY_VAL;
+	}
+
+	// Agents acted as planned since last time step
+	bool is_followed(const State& state) const {
+		if (next_index == EMPTY_VAL || next_index >= joint_actions.size()) {
+			return false;
+		}
+		const auto& predicted_state = predicted_states.at(next_index - 1);
+		return state == predicted_state && state.goal_items == predicted_state.goal_items;
+	}
+
+	std::vector<Joint_Action> joint_actions;	// Actions of all agents, none for agents outside the coalition
+	std::vector<State> predicted_states;		// State after each joint action
+	std::vector<std::pair<size_t, Goal_Progress>> goal_progress;	// By goal id, sorted
+	size_t next_index;
+};
+
 class Planner_Mac : public Planner_Impl {
 
 
 public:
-	Planner_Mac(Environment environment, Agent_Id agent, const State& initial_state, size_t seed = 0);
+	Planner_Mac(Environment environment, Agent_Id agent, const State& initial_state, size_t seed = 0,
+		size_t max_coalition_size = EMPTY_VAL, size_t time_budget = 0);
 	virtual Action get_next_action(const State& state, bool print_state) override;
 
 private:
@@ -386,11 +462,16 @@ private:
 	Paths									get_all_paths(const std::vector<Recipe>& recipes, const State& state);
 	Collaboration_Info						get_best_collaboration(const std::vector<Collaboration_Info>& infos,
 		const std::vector<Collaboration_Info>& probable_infos, const State& state);
-	std::vector<Collaboration_Info>			get_collaboration_permutations(const Goals& goals,
-		const Paths& paths, const std::vector<Agent_Combination>& agent_permutations,
+	Collaboration_Info						get_collaboration_info(const Goals& goals, const Paths& paths,
 		const State& state);
-	Permutations							get_handoff_permutations() const;
-	std::optional<std::vector<Action_Path>> get_permutation_action_paths(const Goals& goals,
+	std::vector<Collaboration_Info>			get_collaboration_permutations(const Goals& goals,
+		const Paths& paths, const State& state);
+	void									get_collaboration_permutations_inner(const Goals& goals,
+		const Paths& paths, const State& state, const std::vector<std::vector<size_t>>& path_lengths,
+		const std::vector<size_t>& remaining_bounds, std::vector<Agent_Id>& handoff_agents, size_t goal_index,
+		size_t bound, size_t& best_length, std::vector<Collaboration_Info>& infos);
+	Action									get_planned_action(const State& state);
+	std::optional<std::vector<Paths::Path_Ptr>> get_permutation_action_paths(const Goals& goals,
 		const Paths& paths) const;
 	size_t									get_permutation_length(const Goals& goals, const Paths& paths);
 	Action									get_random_good_action(const Collaboration_Info& info, const Paths& paths, const State& state);
@@ -398,8 +479,10 @@ private:
 		const Agent_Combination& agents, const State& state) const;
 	bool									ingredients_reachable(const Recipe& recipe, const Agent_Id agent,
 		const Agent_Combination& agents, const State& state) const;
-	void									initialize_reachables(const State& initial_state);
 	bool									is_agent_abused(const Goals& goals, const Paths& paths) const;
+	bool									is_coalition_local(const Agent_Combination& agents, const Recipe& recipe,
+		const State& state) const;
+	bool									is_deadline_passed() const;
 	bool									is_conflict_in_permutation(const State& initial_state,
 		const std::vector<Joint_Action>& actions);
 	bool									is_agent_subset_faster(const Collaboration_Info& info,
@@ -407,13 +490,25 @@ private:
 	Paths									perform_new_search(const State& state, const Goal& goal,
 		const Paths& paths, const std::vector<Joint_Action>& joint_actions, const Agent_Combination& acting_agents, const Action& initial_action = {});
 	bool									temp(const Agent_Combination& agents, const Agent_Id& handoff_agent, const Recipe& recipe, const State& state);
+	void									store_plan(const Collaboration_Info& info, const Paths& paths,
+		const State& state, const Action& action);
 	void									trim_trailing_non_actions(std::vector<Joint_Action>& joint_actions,
 		const Agent_Id& handoff_agent);
 	void									update_recogniser(const Paths& paths, const State& state);
 
 
+	std::shared_ptr<const Goal_Registry> goal_registry;
 	Recogniser recogniser;
 	Search search;
-	std::map<std::pair<Agent_Id, Agent_Combination>, Reachables> agent_reachables;
+	Reachability reachability;
 	size_t time_step;
+	Plan_Cache plan_cache;
+	size_t planned_steps;
+	size_t skipped_steps;
+	size_t max_coalition_size;
+	std::vector<Agent_Combination> agent_combinations;
+	size_t time_budget;		// Milliseconds per planning step, 0 for no budget
+	std::optional<std::chrono::steady_clock::time_point> deadline;
+	std::vector<size_t> previous_lengths;	// By goal id, EMPTY_VAL if unknown
+	std::vector<size_t> estimated_lengths;	// By goal id, goals given a length estimate instead of a path
 };
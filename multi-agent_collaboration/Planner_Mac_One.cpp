@@ -2,6 +2,7 @@
 #include "BFS.hpp"
 #include "A_Star.hpp"
 #include "Search.hpp"
+#include "Reservation_Table.hpp"
 #include "Search_Trimmer.hpp"
 #include "Utils.hpp"
 #include "Recogniser.hpp"
@@ -28,9 +29,9 @@ constexpr auto GAMMA = 1.01;
 constexpr auto GAMMA2 = 1.02;
 
 Planner_Mac_One::Planner_Mac_One(Environment environment, Agent_Id planning_agent, const State& initial_state, size_t seed)
-	: Planner_Impl(environment, planning_agent), time_step(0),
+	: Planner_Impl(environment, planning_agent), time_step(0), goal_registry(std::make_shared<Goal_Registry>(environment)),
 	search(std::make_unique<A_Star>(environment, INITIAL_DEPTH_LIMIT)),
-	recogniser(std::make_unique<Sliding_Recogniser>(environment, initial_state)) {
+	recogniser(std::make_unique<Sliding_Recogniser>(environment, initial_state, goal_registry)) {
 	set_random_seed(0);
 	initialize_reachables(initial_state);
 }
@@ -330,6 +331,7 @@ std::vector<Collaboration_Info> Planner_Mac_One::calculate_probable_multi_goals(
 	}
 
 	// Check if recipes are probable normalised on available tasks
+	auto normalisers = recogniser.get_normalisers(normalisation_goals);
 	for (size_t i = 0; i < infos.size(); ++i) {
 		const auto& info_entry = infos.at(i);
 		std::vector<bool>::reference is_probable = are_probable.at(i);
@@ -342,7 +344,7 @@ std::vector<Collaboration_Info> Planner_Mac_One::calculate_probable_multi_goals(
 				for (const auto& agent : goal.agents) {
 					//bool use_non_probability = agent != planning_agent;
 					bool use_non_probability = (agent != planning_agent || info_entry.goals_size() > 1);
-					if (recogniser.is_probable_normalised(goal, normalisation_goals, agent, planning_agent, use_non_probability)) {
+					if (recogniser.is_probable_normalised(goal, normalisers, agent, planning_agent, use_non_probability)) {
 						inner_probable = true;
 						break;
 					}
@@ -408,6 +410,12 @@ std::map<Goals, float> Planner_Mac_One::calculate_goal_values(std::vector<Collab
 constexpr size_t action_trace_length = 3;
 bool Planner_Mac_One::is_conflict_in_permutation(const State& initial_state, const std::vector<Joint_Action>& actions) {
 
+	// Collisions between agents without simulating, only when the joint actions hold every agent
+	// in order, as the collision check pairs actions with agents by index
+	if (!actions.empty() && actions.front().actions.size() == environment.get_number_of_agents()
+		&& Reservation_Table(environment, initial_state, actions).has_conflict()) {
+		return true;
+	}
 
 	// Perform actions, check for invalid/collisions
 	auto state = initial_state;
@@ -670,17 +678,16 @@ struct Temp_Info {
 	}
 };
 
-// TODO - Would be best to return pointers, but paths is a local variable in one of the calls
-std::optional<std::vector<Action_Path>> Planner_Mac_One::get_permutation_action_paths(const Goals& goals,
+// Shared, so the paths stay valid after a local Paths is destroyed
+std::optional<std::vector<Paths::Path_Ptr>> Planner_Mac_One::get_permutation_action_paths(const Goals& goals,
 	const Paths& paths) const {
-	std::vector<Action_Path> action_paths;
+	std::vector<Paths::Path_Ptr> action_paths;
 	for (const auto& goal : goals.get_iterable()) {
-		auto info_opt = paths.get_handoff(goal);
-		if (info_opt.has_value()) {
-			action_paths.push_back(*info_opt.value());
-		} else {
+		const auto& path = paths.get_shared_path(goal_registry->get_id(goal));
+		if (path == nullptr) {
 			return {};
 		}
+		action_paths.push_back(path);
 	}
 	return action_paths;
 }
@@ -790,7 +797,7 @@ Paths Planner_Mac_One::perform_new_search(const State& state, const Goal& goal,
 
 	auto new_path = search.search_joint(state, goal.recipe, goal.agents, goal.handoff_agent, joint_actions, acting_agents, initial_action);
 	if (new_path.empty()) {
-		return {};
+		return Paths(goal_registry);
 	}
 	Search_Trimmer trim;
 	trim.trim_forward(new_path, state, environment, goal.recipe);
@@ -902,7 +909,7 @@ bool Planner_Mac_One::temp(const Agent_Combination& agents, const Agent_Id& hand
 }
 
 Paths Planner_Mac_One::get_all_paths(const std::vector<Recipe>& recipes, const State& state) {
-	Paths paths;
+	Paths paths(goal_registry);
 	auto agent_combinations = get_combinations(environment.get_number_of_agents());
 
 	auto recipe_size = recipes.size();
@@ -988,9 +995,9 @@ Paths Planner_Mac_One::get_all_paths(const std::vector<Recipe>& recipes, const S
 }
 
 void Planner_Mac_One::update_recogniser(const Paths& paths, const State& state) {
-	std::map<Goal, size_t> goal_lengths;
-	for (const auto& [goal, path] : paths.get_handoff()) {
-		goal_lengths.insert({ goal, path->size() });
+	std::vector<size_t> goal_lengths(goal_registry->size(), EMPTY_VAL);
+	for (auto id : paths.get_goal_ids()) {
+		goal_lengths.at(id) = paths.get_path(id)->size();
 	}
 	recogniser.update(goal_lengths, state);
 }
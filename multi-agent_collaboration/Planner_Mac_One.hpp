@@ -36,7 +36,7 @@ private:
 		const Paths& paths, const std::vector<Agent_Combination>& agent_permutations,
 		const State& state);
 	Permutations							get_handoff_permutations() const;
-	std::optional<std::vector<Action_Path>> get_permutation_action_paths(const Goals& goals,
+	std::optional<std::vector<Paths::Path_Ptr>> get_permutation_action_paths(const Goals& goals,
 		const Paths& paths) const;
 	size_t									get_permutation_length(const Goals& goals, const Paths& paths);
 	Action									get_random_good_action(const Collaboration_Info& info, const Paths& paths, const State& state);
@@ -58,6 +58,7 @@ private:
 	void									update_recogniser(const Paths& paths, const State& state);
 
 
+	std::shared_ptr<const Goal_Registry> goal_registry;
 	Recogniser recogniser;
 	Search search;
 	std::map<std::pair<Agent_Id, Agent_Combination>, Reachables> agent_reachables;
@@ -0,0 +1,194 @@
+#include "Reachability.hpp"
+
+#include <algorithm>
+#include <bitset>
+
+constexpr size_t WORD_BITS = 64;
+constexpr size_t NEIGHBOUR_COUNT = 4;
+
+Reachability::Reachability(const Environment& environment, const State& initial_state,
+	size_t max_coalition_size)
+	: width(environment.get_width()), height(environment.get_height()),
+	number_of_agents(initial_state.agents.size()), max_coalition_size(max_coalition_size),
+	cell_count(width* height),
+	words_per_grid((cell_count + WORD_BITS - 1) / WORD_BITS),
+	floor(cell_count, false), neighbours(cell_count* NEIGHBOUR_COUNT, EMPTY_VAL),
+	components(cell_count, EMPTY_VAL), component_reachables(),
+	reachables((number_of_agents << number_of_agents)* words_per_grid, 0),
+	entry_keys((number_of_agents << number_of_agents)* number_of_agents, EMPTY_VAL),
+	agent_cells(number_of_agents, EMPTY_VAL), key(number_of_agents, EMPTY_VAL),
+	frontier(), blocked(cell_count, false) {
+
+	frontier.reserve(cell_count);
+	for (size_t x = 0; x < width; ++x) {
+		for (size_t y = 0; y < height; ++y) {
+			Coordinate coordinate{ x, y };
+			auto cell = get_cell(coordinate);
+			floor.at(cell) = !environment.is_cell_type(coordinate, Cell_Type::WALL);
+
+			auto* cell_neighbours = &neighbours.at(cell * NEIGHBOUR_COUNT);
+			if (y > 0) cell_neighbours[0] = get_cell({ x, y - 1 });
+			if (x + 1 < width) cell_neighbours[1] = get_cell({ x + 1, y });
+			if (y + 1 < height) cell_neighbours[2] = get_cell({ x, y + 1 });
+			if (x > 0) cell_neighbours[3] = get_cell({ x - 1, y });
+		}
+	}
+	initialize_components();
+	update(initial_state);
+}
+
+void Reachability::initialize_components() {
+	size_t component_count = 0;
+	for (size_t start_cell = 0; start_cell < cell_count; ++start_cell) {
+		if (!floor.at(start_cell) || components.at(start_cell) != EMPTY_VAL) {
+			continue;
+		}
+
+		size_t component = component_count++;
+		component_reachables.resize(component_count * words_per_grid, 0);
+		auto* bits = &component_reachables.at(component * words_per_grid);
+
+		components.at(start_cell) = component;
+		bits[start_cell / WORD_BITS] |= uint64_t{ 1 } << (start_cell % WORD_BITS);
+		frontier.push_back(start_cell);
+		while (!frontier.empty()) {
+			auto cell = frontier.back();
+			frontier.pop_back();
+			for (size_t i = 0; i < NEIGHBOUR_COUNT; ++i) {
+				auto neighbour = neighbours.at(cell * NEIGHBOUR_COUNT + i);
+				if (neighbour == EMPTY_VAL) {
+					continue;
+				}
+				bits[neighbour / WORD_BITS] |= uint64_t{ 1 } << (neighbour % WORD_BITS);
+				if (floor.at(neighbour) && components.at(neighbour) == EMPTY_VAL) {
+					components.at(neighbour) = component;
+					frontier.push_back(neighbour);
+				}
+			}
+		}
+	}
+}
+
+void Reachability::update(const State& state) {
+	for (size_t agent = 0; agent < number_of_agents; ++agent) {
+		agent_cells.at(agent) = get_cell(state.get_location(agent));
+	}
+
+	for (size_t agent = 0; agent < number_of_agents; ++agent) {
+		auto agent_cell = agent_cells.at(agent);
+		auto component = components.at(agent_cell);
+
+		for (size_t mask = 0; mask < (size_t{ 1 } << number_of_agents); ++mask) {
+			if ((mask & (size_t{ 1 } << agent))
+				|| std::bitset<64>(mask).count() >= max_coalition_size) {
+				continue;
+			}
+
+			// Only agents inside the component of the agent can block it
+			bool has_blocker = false;
+			for (size_t other = 0; other < number_of_agents; ++other) {
+				auto other_cell = agent_cells.at(other);
+				if (other == agent) {
+					key.at(other) = other_cell;
+				}
+				else if (!(mask & (size_t{ 1 } << other)) && components.at(other_cell) == component) {
+					key.at(other) = other_cell;
+					has_blocker = true;
+				}
+				else {
+					key.at(other) = EMPTY_VAL;
+				}
+			}
+
+			auto entry = get_entry(agent, mask);
+			auto entry_key = entry_keys.begin() + entry * number_of_agents;
+			if (std::equal(key.begin(), key.end(), entry_key)) {
+				continue;
+			}
+			std::copy(key.begin(), key.end(), entry_key);
+
+			if (has_blocker) {
+				flood_fill(entry, agent_cell);
+			}
+			else {
+				std::copy_n(component_reachables.begin() + component * words_per_grid, words_per_grid,
+					reachables.begin() + entry * words_per_grid);
+			}
+		}
+	}
+}
+
+void Reachability::flood_fill(size_t entry, size_t start_cell) {
+	for (size_t other = 0; other < number_of_agents; ++other) {
+		if (key.at(other) != EMPTY_VAL) {
+			blocked.at(key.at(other)) = true;
+		}
+	}
+	blocked.at(start_cell) = false;
+
+	auto* bits = &reachables.at(entry * words_per_grid);
+	std::fill_n(bits, words_per_grid, 0);
+	bits[start_cell / WORD_BITS] |= uint64_t{ 1 } << (start_cell % WORD_BITS);
+	frontier.push_back(start_cell);
+	while (!frontier.empty()) {
+		auto cell = frontier.back();
+		frontier.pop_back();
+		for (size_t i = 0; i < NEIGHBOUR_COUNT; ++i) {
+			auto neighbour = neighbours.at(cell * NEIGHBOUR_COUNT + i);
+			if (neighbour == EMPTY_VAL) {
+				continue;
+			}
+			auto& word = bits[neighbour / WORD_BITS];
+			auto bit = uint64_t{ 1 } << (neighbour % WORD_BITS);
+			if (word & bit) {
+				continue;
+			}
+			word |= bit;
+			if (floor.at(neighbour) && !blocked.at(neighbour)) {
+				frontier.push_back(neighbour);
+			}
+		}
+	}
+
+	for (size_t other = 0; other < number_of_agents; ++other) {
+		if (key.at(other) != EMPTY_VAL) {
+			blocked.at(key.at(other)) = false;
+		}
+	}
+}
+
+bool Reachability::is_reachable(const Agent_Id& agent, const Agent_Combination& agents, const Coordinate& location) const {
+	auto cell = get_cell(location);
+	auto word = reachables.at(get_entry(agent, get_mask(agents)) * words_per_grid + cell / WORD_BITS);
+	return (word >> (cell % WORD_BITS)) & 1;
+}
+
+// If the agents share a reachable cell, e.g. a wall they can hand off items on
+bool Reachability::is_overlapping(const Agent_Id& agent1, const Agent_Combination& agents1,
+	const Agent_Id& agent2, const Agent_Combination& agents2) const {
+
+	auto bits1 = reachables.begin() + get_entry(agent1, get_mask(agents1)) * words_per_grid;
+	auto bits2 = reachables.begin() + get_entry(agent2, get_mask(agents2)) * words_per_grid;
+	for (size_t i = 0; i < words_per_grid; ++i) {
+		if (bits1[i] & bits2[i]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+size_t Reachability::get_cell(const Coordinate& coordinate) const {
+	return coordinate.second * width + coordinate.first;
+}
+
+size_t Reachability::get_mask(const Agent_Combination& agents) const {
+	size_t mask = 0;
+	for (const auto& agent : agents) {
+		mask |= size_t{ 1 } << agent.id;
+	}
+	return mask;
+}
+
+size_t Reachability::get_entry(const Agent_Id& agent, size_t mask) const {
+	return (agent.id << number_of_agents) + mask;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Environment.hpp"
+#include "State.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Cells reachable by an agent, when a subset of the other agents is assumed to move out of the way.
+// Reached cells include the walls next to reachable floor cells, and the cells of blocking agents.
+// Connected floor components are computed once, an entry is only flood filled when an agent blocks
+// inside the component of the agent and the agent positions changed since the last update.
+// Entries for masks larger than the maximum coalition size are not maintained.
+class Reachability {
+public:
+	Reachability(const Environment& environment, const State& initial_state,
+		size_t max_coalition_size = EMPTY_VAL);
+	void update(const State& state);
+	bool is_reachable(const Agent_Id& agent, const Agent_Combination& agents, const Coordinate& location) const;
+	bool is_overlapping(const Agent_Id& agent1, const Agent_Combination& agents1,
+		const Agent_Id& agent2, const Agent_Combination& agents2) const;
+
+private:
+	size_t	get_cell(const Coordinate& coordinate) const;
+	size_t	get_entry(const Agent_Id& agent, size_t mask) const;
+	size_t	get_mask(const Agent_Combination& agents) const;
+	void	flood_fill(size_t entry, size_t start_cell);
+	void	initialize_components();
+
+	size_t width;
+	size_t height;
+	size_t number_of_agents;
+	size_t max_coalition_size;
+	size_t cell_count;
+	size_t words_per_grid;
+
+	std::vector<bool>		floor;					// Non-wall cells
+	std::vector<size_t>		neighbours;				// 4 per cell, EMPTY_VAL outside grid
+	std::vector<size_t>		components;				// Floor component per cell, EMPTY_VAL for walls
+	std::vector<uint64_t>	component_reachables;	// Per component, floor cells and adjacent walls
+	std::vector<uint64_t>	reachables;				// Per agent and mask of non-blocking agents
+	std::vector<size_t>		entry_keys;				// Agent cell and blocking cells used for each entry
+	std::vector<size_t>		agent_cells;
+	std::vector<size_t>		key;
+	std::vector<size_t>		frontier;
+	std::vector<bool>		blocked;
+};
@@ -150,12 +150,14 @@ public:
 	Recogniser_Method(const Environment& environment, const State& initial_state) 
 		: environment(environment), state(initial_state) {}
 
-	virtual void update(const std::map<Goal, size_t>& goal_lengths, const State& state) = 0;
+	// Lengths are indexed by goal id, EMPTY_VAL for goals without a path
+	virtual void update(const std::vector<size_t>& goal_lengths, const State& state) = 0;
 	virtual Goal get_goal(Agent_Id agent) = 0;
 	virtual std::map<Agent_Id, Goal> get_goals() const = 0;
 	virtual std::map<Goal, float> get_raw_goals() const = 0;
 	virtual bool is_probable(Goal goal) const = 0;
-	virtual bool is_probable_normalised(Goal goal, const std::vector<Goal>& available_goals, Agent_Id agent, Agent_Id planning_agent, bool use_non_probability) const = 0;
+	virtual std::vector<float> get_normalisers(const std::vector<Goal>& available_goals) const = 0;
+	virtual bool is_probable_normalised(Goal goal, const std::vector<float>& normalisers, Agent_Id agent, Agent_Id planning_agent, bool use_non_probability) const = 0;
 	virtual void print_probabilities() const = 0;
 	virtual float get_probability(const Goal& goal) const = 0;
 
@@ -170,7 +172,7 @@ public:
 	Recogniser(std::unique_ptr<Recogniser_Method> recogniser_method) 
 		: recogniser_method(std::move(recogniser_method)) {}
 	
-	void update(const std::map<Goal, size_t>& goal_lengths, const State& state) {
+	void update(const std::vector<size_t>& goal_lengths, const State& state) {
 		recogniser_method->update(goal_lengths, state); 
 	}
 	
@@ -191,8 +193,13 @@ public:
 		return recogniser_method->is_probable(goal);
 	}
 
-	virtual bool is_probable_normalised(Goal goal, const std::vector<Goal>& available_goals, Agent_Id agent, Agent_Id planning_agent, bool use_non_probability) const {
-		return recogniser_method->is_probable_normalised(goal, available_goals, agent, planning_agent, use_non_probability);
+	// Per agent normalisers for is_probable_normalised, computed once for a set of available goals
+	std::vector<float> get_normalisers(const std::vector<Goal>& available_goals) const {
+		return recogniser_method->get_normalisers(available_goals);
+	}
+
+	virtual bool is_probable_normalised(Goal goal, const std::vector<float>& normalisers, Agent_Id agent, Agent_Id planning_agent, bool use_non_probability) const {
+		return recogniser_method->is_probable_normalised(goal, normalisers, agent, planning_agent, use_non_probability);
 	}
 
 	void print_probabilities() const {
@@ -0,0 +1,85 @@
+#include "Reservation_Table.hpp"
+
+Reservation_Table::Reservation_Table()
+	: height(0), cells(0), length(0), colliding(false), reserved_agents(), reserved() {}
+
+Reservation_Table::Reservation_Table(const Environment& environment, const State& state,
+	const std::vector<Joint_Action>& actions, const Agent_Combination& free_agents)
+	: height(environment.get_height()), cells(environment.get_width()* environment.get_height()),
+	length(actions.size()), colliding(false), reserved_agents(environment.get_number_of_agents(), false), reserved() {
+
+	if (actions.empty()) {
+		return;
+	}
+	reserved.resize((length + 1) * cells, 0);
+
+	// Reserved agents by their index in the joint actions
+	std::vector<size_t> indices;
+	std::vector<Coordinate> coordinates;
+	std::vector<size_t> current_cells;
+	std::vector<size_t> next_cells;
+	const auto& first_actions = actions.front().actions;
+	for (size_t index = 0; index < first_actions.size(); ++index) {
+		const auto& agent = first_actions.at(index).agent;
+		if (!free_agents.contains(agent)) {
+			reserved_agents.at(agent.id) = true;
+			indices.push_back(index);
+			coordinates.push_back(state.agents.at(agent.id).coordinate);
+			next_cells.push_back(convert(coordinates.back()));
+			++reserved.at(next_cells.back());
+		}
+	}
+
+	for (size_t time = 0; time < length; ++time) {
+		std::swap(current_cells, next_cells);
+		next_cells.clear();
+		const auto& joint_action = actions.at(time);
+		for (size_t i = 0; i < indices.size(); ++i) {
+			coordinates.at(i) = environment.move(coordinates.at(i), joint_action.actions.at(indices.at(i)).direction);
+			next_cells.push_back(convert(coordinates.at(i)));
+			++reserved.at((time + 1) * cells + next_cells.back());
+		}
+
+		// The pairwise rules of the collision check, excluding the agent itself
+		for (size_t i = 0; i < indices.size() && !colliding; ++i) {
+			auto current = current_cells.at(i);
+			auto next = next_cells.at(i);
+			auto self = current == next ? 1 : 0;
+			colliding = reserved.at((time + 1) * cells + next) > 1
+				|| reserved.at(time * cells + next) > self
+				|| reserved.at((time + 1) * cells + current) > self;
+		}
+	}
+}
+
+// Conflict for an agent which is not reserved, moving from current to next between time and time + 1
+bool Reservation_Table::is_conflict(const Coordinate& current, const Coordinate& next, size_t time) const {
+	if (time >= length) {
+		return false;
+	}
+	auto current_cell = convert(current);
+	auto next_cell = convert(next);
+	return is_occupied(next_cell, time + 1)
+		|| is_occupied(next_cell, time)
+		|| is_occupied(current_cell, time + 1);
+}
+
+bool Reservation_Table::is_reserved(const Agent_Id& agent) const {
+	return agent.id < reserved_agents.size() && reserved_agents.at(agent.id);
+}
+
+bool Reservation_Table::has_conflict() const {
+	return colliding;
+}
+
+size_t Reservation_Table::get_length() const {
+	return length;
+}
+
+size_t Reservation_Table::convert(const Coordinate& coordinate) const {
+	return coordinate.first * height + coordinate.second;
+}
+
+bool Reservation_Table::is_occupied(size_t cell, size_t time) const {
+	return reserved[time * cells + cell] != 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Environment.hpp"
+#include "State.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// Cells occupied per time step by the agents following fixed joint actions, built once from the actions.
+// Agents not in the joint actions, and free agents, are not reserved. Positions follow Environment::move
+// like the collision check of Environment::act, so they hold as long as all earlier joint actions succeed.
+// Under that check an agent moving from current to next collides with a reserved agent at next at either
+// time, or with one entering current, so swaps are answered by the same cell lookups as vertex conflicts.
+class Reservation_Table {
+public:
+	Reservation_Table();
+	Reservation_Table(const Environment& environment, const State& state,
+		const std::vector<Joint_Action>& actions, const Agent_Combination& free_agents = {});
+	bool	is_conflict(const Coordinate& current, const Coordinate& next, size_t time) const;
+	bool	is_reserved(const Agent_Id& agent) const;
+	bool	has_conflict() const;
+	size_t	get_length() const;
+
+private:
+	size_t	convert(const Coordinate& coordinate) const;
+	bool	is_occupied(size_t cell, size_t time) const;
+
+	size_t height;
+	size_t cells;
+	size_t length;					// Joint actions, positions are reserved for times 0 to length
+	bool colliding;					// Reserved agents collide among themselves
+	std::vector<bool> reserved_agents;
+	std::vector<uint8_t> reserved;	// Reserved agents, indexed by time * cells + cell
+};
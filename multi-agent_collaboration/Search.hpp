@@ -1,6 +1,9 @@
 #pragma once
 
+#include <chrono>
+#include <map>
 #include <memory>
+#include <optional>
 #include "Environment.hpp"
 #include "State.hpp"
 
@@ -57,17 +60,46 @@ namespace std {
 
 class Search_Method {
 public:
-	Search_Method(const Environment& environment, size_t depth_limit) : environment(environment), depth_limit(depth_limit) {}
+	Search_Method(const Environment& environment, size_t depth_limit) : environment(environment), depth_limit(depth_limit), deadline() {}
 	virtual std::vector<Joint_Action> search_joint(const State& state,
 		Recipe recipe, const Agent_Combination& agents, Agent_Id handoff_agent,
 		const std::vector<Joint_Action>& input_actions, const Agent_Combination& free_agents, const Action& initial_action) = 0;
 	virtual std::pair<size_t, Direction> get_dist_direction(Coordinate source, Coordinate dest, size_t walls) = 0;
+
+	// Lower bound on the path length of the goal without searching, EMPTY_VAL if not available
+	virtual size_t estimate_length(const State& state, Recipe recipe, const Agent_Combination& agents,
+		Agent_Id handoff_agent) = 0;
+
+	// Paths for several recipes of the same agents, recipes without a path are left out.
+	// Searches each recipe by default, methods which explore once for all recipes override it
+	virtual std::map<Recipe, std::vector<Joint_Action>> search_joint_multi(const State& state,
+		const std::vector<Recipe>& recipes, const Agent_Combination& agents, Agent_Id handoff_agent) {
+
+		std::map<Recipe, std::vector<Joint_Action>> paths;
+		for (const auto& recipe : recipes) {
+			auto path = search_joint(state, recipe, agents, handoff_agent, {}, {}, {});
+			if (!path.empty()) {
+				paths.emplace(recipe, std::move(path));
+			}
+		}
+		return paths;
+	}
+
+	// Searches give up (no path) once the deadline has passed
+	void set_deadline(std::optional<std::chrono::steady_clock::time_point> deadline) {
+		this->deadline = deadline;
+	}
 protected:
 		template<typename T>
 		std::vector<Joint_Action> extract_actions(size_t goal_id, const std::vector<T>& states) const;
 
+		bool is_deadline_passed() const {
+			return deadline.has_value() && std::chrono::steady_clock::now() >= deadline.value();
+		}
+
 		Environment environment;
 		size_t depth_limit;
+		std::optional<std::chrono::steady_clock::time_point> deadline;
 };
 
 class Search {
@@ -83,6 +115,16 @@ public:
 	std::pair<size_t, Direction> get_dist_direction(Coordinate source, Coordinate dest, size_t walls) {
 		return search_method->get_dist_direction(source, dest, walls);
 	}
+	size_t estimate_length(const State& state, Recipe recipe, const Agent_Combination& agents, Agent_Id handoff_agent) {
+		return search_method->estimate_length(state, recipe, agents, handoff_agent);
+	}
+	std::map<Recipe, std::vector<Joint_Action>> search_joint_multi(const State& state, const std::vector<Recipe>& recipes,
+		const Agent_Combination& agents, Agent_Id handoff_agent) {
+		return search_method->search_joint_multi(state, recipes, agents, handoff_agent);
+	}
+	void set_deadline(std::optional<std::chrono::steady_clock::time_point> deadline) {
+		search_method->set_deadline(deadline);
+	}
 private:
 	std::unique_ptr<Search_Method> search_method;
 };
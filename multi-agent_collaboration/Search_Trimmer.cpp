@@ -38,28 +38,52 @@ std::vector<Joint_Action> Search_Trimmer::apply_modified_actions(size_t start_in
 	return modified_actions;
 }
 
+// An agent is trimmed at the latest index where the result exists after simulating up to the index with
+// the agent (and the agents trimmed before it) idle. Idle prefixes of different indices share their
+// simulation, so each agent is simulated once, and again only when another agent is trimmed.
 void Search_Trimmer::trim_forward(std::vector<Joint_Action>& actions, const State& state, const Environment& environment, const Recipe& recipe) const {
 
-	std::vector<bool> agent_done;
-	for (size_t agent = 0; agent < environment.get_number_of_agents(); ++agent) {
-		agent_done.push_back(false);
-	}
-	
-	State baseline_state = state;
+	size_t agent_count = environment.get_number_of_agents();
+	std::vector<bool> agent_done(agent_count, false);
+	std::vector<std::vector<bool>> has_result(agent_count);
+	size_t done_count = 0;
 	bool done = false;
-	for (int action_index = actions.size()-1; action_index >= 0 && !done; --action_index) {
-		for (size_t agent = 0; agent < environment.get_number_of_agents(); ++agent) {
-			if (agent_done.at(agent)) continue;
-			State current_state = baseline_state;
 
-			auto modified_actions = apply_modified_actions(0, action_index, agent, current_state, environment, actions);
+	for (size_t agent = 0; agent < agent_count && !actions.empty(); ++agent) {
+		simulate_idle(agent, actions.size() - 1, state, environment, actions, recipe, has_result.at(agent));
+	}
+
+	for (int action_index = actions.size()-1; action_index >= 0 && !done; --action_index) {
+		for (size_t agent = 0; agent < agent_count; ++agent) {
+			if (agent_done.at(agent) || !has_result.at(agent).at(action_index)) continue;
 
-			if (current_state.contains_item(recipe.result)) {
-				actions = modified_actions;
-				agent_done.at(agent) = true;
+			for (int index = 0; index <= action_index; ++index) {
+				actions.at(index).update_action(agent, Direction::NONE);
+			}
+			agent_done.at(agent) = true;
+			++done_count;
+			done |= (done_count == agent_count - 1);
 
-				done |= (std::count(agent_done.begin(), agent_done.end(), true) == environment.get_number_of_agents() - 1);
+			// Remaining agents are checked with this agent idle
+			for (size_t other = 0; other < agent_count; ++other) {
+				if (!agent_done.at(other)) {
+					simulate_idle(other, action_index, state, environment, actions, recipe, has_result.at(other));
+				}
 			}
 		}
 	}
 }
+
+// Records if the result exists after each action up to end_index, when the agent is idle
+void Search_Trimmer::simulate_idle(size_t agent, size_t end_index, const State& state, const Environment& environment,
+	const std::vector<Joint_Action>& actions, const Recipe& recipe, std::vector<bool>& has_result) const {
+
+	has_result.resize(end_index + 1);
+	State current_state = state;
+	for (size_t action_index = 0; action_index <= end_index; ++action_index) {
+		auto action = actions.at(action_index);
+		action.update_action(agent, Direction::NONE);
+		environment.act(current_state, action, Print_Level::NOPE);
+		has_result.at(action_index) = current_state.contains_item(recipe.result);
+	}
+}
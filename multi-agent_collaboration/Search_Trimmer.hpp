@@ -10,5 +10,7 @@ public:
 	void trim(std::vector<Joint_Action>& actions, const State& state, const Environment& environment, const Recipe& recipe) const;
 	void trim_forward(std::vector<Joint_Action>& actions, const State& state, const Environment& environment, const Recipe& recipe) const;
 private:
+	void simulate_idle(size_t agent, size_t end_index, const State& state, const Environment& environment,
+		const std::vector<Joint_Action>& actions, const Recipe& recipe, std::vector<bool>& has_result) const;
 	std::vector<Joint_Action> apply_modified_actions(size_t action_index, size_t end_index, size_t agent, State& current_state, const Environment& environment, const std::vector<Joint_Action>& actions) const;
 };
\ No newline at end of file
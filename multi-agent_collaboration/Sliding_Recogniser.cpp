@@ -3,35 +3,72 @@
 #include "Core.hpp"
 #include "Utils.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 #include <iomanip>
 
-constexpr auto WINDOW_SIZE = 4; 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RECOGNISER_SSE2
+#endif
+
 constexpr auto alpha = 100.0f;			// Inverse weight of solution length in goal probability
 constexpr auto beta = 0.9f;				// Adjust NONE probability scale
 constexpr auto charlie = 0.8;			// Threshold for goal being probable
 constexpr auto delta = 1.05;				// Collaboration penalty
 
-Sliding_Recogniser::Sliding_Recogniser(const Environment& environment, const State& initial_state)
-	: Recogniser_Method(environment, initial_state), goals(), time_step(0) {
+Sliding_Recogniser::Sliding_Recogniser(const Environment& environment, const State& initial_state,
+	std::shared_ptr<const Goal_Registry> goal_registry, size_t max_coalition_size)
+	: Recogniser_Method(environment, initial_state), goal_registry(goal_registry),
+	goals(goal_registry->size()), goal_ids(), probability_batch(), time_step(0), agent_combinations() {
 	for (size_t agent = 0; agent < environment.get_number_of_agents(); ++agent) {
 		Goal goal{ agent , EMPTY_RECIPE, EMPTY_VAL };
-		goals.insert({ goal,  {} }); 
+		track(goal_registry->get_id(goal), {});
 		//agents_active_status.emplace_back();
 	}
+
+	// Coalitions which goals can be recognised for
+	std::vector<Agent_Id> all_agents;
+	for (size_t i = 0; i < environment.get_number_of_agents(); ++i) {
+		all_agents.push_back({ i });
+	}
+	for (size_t i = 0; i < environment.get_number_of_agents() && i < max_coalition_size; ++i) {
+		for (auto& combination : get_combinations<Agent_Id>({ all_agents }, i + 1)) {
+			agent_combinations.push_back(Agent_Combination{ combination });
+		}
+	}
 }
 
-void Sliding_Recogniser::insert(const std::map<Goal, size_t>& goal_lengths, const State& state) {
-	for (const auto& [goal, length] : goal_lengths) {
-		auto it = goals.find(goal);
-		if (it == goals.end()) {
-			goals.insert({ goal, Goal_Entry{length, time_step} });
+void Sliding_Recogniser::track(size_t id, const Goal_Entry& entry) {
+	goals.at(id) = entry;
+	goals.at(id).is_tracked = true;
+	goal_ids.insert(std::lower_bound(goal_ids.begin(), goal_ids.end(), id), id);
+}
+
+const Goal_Entry* Sliding_Recogniser::find(const Goal& goal) const {
+	const auto& entry = goals.at(goal_registry->get_id(goal));
+	return entry.is_tracked ? &entry : nullptr;
+}
+
+void Sliding_Recogniser::insert(const std::vector<size_t>& goal_lengths, const State& state) {
+	for (size_t id = 0; id < goal_lengths.size(); ++id) {
+		auto length = goal_lengths.at(id);
+		if (length == EMPTY_VAL) {
+			continue;
+		}
+		auto& entry = goals.at(id);
+		if (!entry.is_tracked) {
+			track(id, Goal_Entry{ length, time_step });
 		} else {
-			it->second.add(length, time_step);
+			entry.add(length, time_step);
+			entry.last_seen = time_step;
 		}
 	}
 
-	for (auto& [key, val] : goals) {
+	for (auto id : goal_ids) {
+		const auto& key = goal_registry->get_goal(id);
+		auto& val = goals.at(id);
 		if (val.is_current(time_step)) {
 			continue;
 		}
@@ -43,35 +80,111 @@ void Sliding_Recogniser::insert(const std::map<Goal, size_t>& goal_lengths, cons
 	}
 }
 
+// Goals which have not been given a length for a full window are dropped, they are inserted as new
+// goals if they return. NONE goals are kept.
+void Sliding_Recogniser::evict_stale_goals() {
+	auto is_stale = [this](size_t id) {
+		const auto& entry = goals.at(id);
+		if (goal_registry->get_goal(id).recipe == EMPTY_RECIPE || entry.last_seen + WINDOW_SIZE >= time_step) {
+			return false;
+		}
+		goals.at(id) = {};
+		return true;
+	};
+	goal_ids.erase(std::remove_if(goal_ids.begin(), goal_ids.end(), is_stale), goal_ids.end());
+}
+
+// length_probs = alpha / (old_length + alpha), progress_probs = old_length / progress_length
+static void calculate_length_probabilities(const float* old_lengths, const float* progress_lengths,
+	float* length_probs, float* progress_probs, size_t count) {
+
+	size_t i = 0;
+#ifdef RECOGNISER_SSE2
+	auto alpha_ps = _mm_set1_ps(alpha);
+	for (; i + 4 <= count; i += 4) {
+		auto old_length = _mm_loadu_ps(old_lengths + i);
+		_mm_storeu_ps(length_probs + i, _mm_div_ps(alpha_ps, _mm_add_ps(old_length, alpha_ps)));
+		_mm_storeu_ps(progress_probs + i, _mm_div_ps(old_length, _mm_loadu_ps(progress_lengths + i)));
+	}
+#endif
+	for (; i < count; ++i) {
+		length_probs[i] = alpha / (old_lengths[i] + alpha);
+		progress_probs[i] = old_lengths[i] / progress_lengths[i];
+	}
+}
+
+// Clamps progress_probs to [0, 1], probabilities = length_prob * (new goal ? penalty : progress_prob).
+// Operand order of min and max keeps NaN progress like std::min and std::max do.
+static void calculate_goal_probabilities(const float* length_probs, float* progress_probs,
+	const int32_t* new_goal_masks, float* probabilities, size_t count) {
+
+	constexpr float new_goal_penalty = 0.8f;
+	size_t i = 0;
+#ifdef RECOGNISER_SSE2
+	auto zero = _mm_setzero_ps();
+	auto one = _mm_set1_ps(1.0f);
+	auto penalty = _mm_set1_ps(new_goal_penalty);
+	for (; i + 4 <= count; i += 4) {
+		auto progress = _mm_max_ps(zero, _mm_min_ps(one, _mm_loadu_ps(progress_probs + i)));
+		_mm_storeu_ps(progress_probs + i, progress);
+		auto is_new = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(new_goal_masks + i)));
+		auto factor = _mm_or_ps(_mm_and_ps(is_new, penalty), _mm_andnot_ps(is_new, progress));
+		_mm_storeu_ps(probabilities + i, _mm_mul_ps(_mm_loadu_ps(length_probs + i), factor));
+	}
+#endif
+	for (; i < count; ++i) {
+		progress_probs[i] = std::max(std::min(progress_probs[i], 1.0f), 0.0f);
+		probabilities[i] = length_probs[i] * (new_goal_masks[i] != 0 ? new_goal_penalty : progress_probs[i]);
+	}
+}
+
+// Window values of the current goals are gathered into contiguous arrays, which are updated in batch
 float Sliding_Recogniser::update_standard_probabilities(size_t base_window_index){
-	float max_prob = 0.0f;
-	for (auto& [key, val] : goals) {
+	auto& batch = probability_batch;
+	batch.clear();
+	for (auto id : goal_ids) {
+		auto& val = goals.at(id);
 		if (!val.is_current(time_step)) {
 			continue;
 		}
 
 		size_t window_index = val.get_non_empty_index(base_window_index);
-		size_t window_length = time_step - window_index - 1;
 		if (window_index == EMPTY_VAL) {
 			val.probability = EMPTY_PROB;
-		} else {
-			auto old_length = val.lengths.at(window_index);
-			//auto length_prob = (alpha / (new_length + alpha));
-			auto length_prob = (alpha / (old_length + alpha));
-			//val.probability = (alpha * 1.0f / val.lengths.at(window_index))
-			auto progress_prob = ((float)val.lengths.at(window_index)) / (val.lengths.at(time_step - 1) + window_length);
-			progress_prob = std::pow(progress_prob, 1 + (key.agents.size() - 1) * 0.5);
-			progress_prob = std::max(std::min(progress_prob, 1.0f), 0.0f);
-
-			if (window_length == 0) {
-				constexpr float new_goal_penalty = 0.8f;
-				val.probability = length_prob * new_goal_penalty;
-				val.length_prob = length_prob;		// debug
-			} else {
-				val.probability = length_prob * progress_prob;
-				val.length_prob = length_prob;		// debug
-				val.progress_prob = progress_prob;	// debug
-			}
+			continue;
+		}
+		size_t window_length = time_step - window_index - 1;
+		batch.ids.push_back(id);
+		batch.old_lengths.push_back(static_cast<float>(val.at(window_index)));
+		batch.progress_lengths.push_back(static_cast<float>(val.at(time_step - 1) + window_length));
+		batch.new_goal_masks.push_back(window_length == 0 ? -1 : 0);
+	}
+
+	size_t count = batch.ids.size();
+	batch.length_probs.resize(count);
+	batch.progress_probs.resize(count);
+	batch.probabilities.resize(count);
+	calculate_length_probabilities(batch.old_lengths.data(), batch.progress_lengths.data(),
+		batch.length_probs.data(), batch.progress_probs.data(), count);
+
+	// Progress of coalitions is weighted by their size, single agent goals have exponent 1
+	for (size_t i = 0; i < count; ++i) {
+		auto agents_size = goal_registry->get_goal(batch.ids[i]).agents.size();
+		if (agents_size > 1) {
+			batch.progress_probs[i] = static_cast<float>(std::pow(batch.progress_probs[i], 1 + (agents_size - 1) * 0.5));
+		}
+	}
+
+	calculate_goal_probabilities(batch.length_probs.data(), batch.progress_probs.data(),
+		batch.new_goal_masks.data(), batch.probabilities.data(), count);
+
+	float max_prob = 0.0f;
+	for (size_t i = 0; i < count; ++i) {
+		auto& val = goals.at(batch.ids[i]);
+		val.probability = batch.probabilities[i];
+		val.length_prob = batch.length_probs[i];					// debug
+		if (batch.new_goal_masks[i] == 0) {
+			val.progress_prob = batch.progress_probs[i];			// debug
 		}
 		if (val.probability > max_prob) max_prob = val.probability;
 	}
@@ -83,19 +196,11 @@ float Sliding_Recogniser::update_non_probabilities(size_t base_window_index, siz
 	std::vector<float> max_progress(number_of_agents, 0.0f);
 	//std::vector<bool> agents_useful(number_of_agents, false);
 
-	std::vector<Agent_Id> all_agents;
-	std::vector<std::vector<Agent_Combination>> agent_permutations(number_of_agents, std::vector<Agent_Combination>());
-	for (size_t i = 0; i < number_of_agents; ++i) {
-		all_agents.push_back({ i });
-	}
-	for (size_t i = 0; i < number_of_agents; ++i) {
-		for (auto& combination : get_combinations<Agent_Id>({ all_agents }, i + 1)) {
-			agent_permutations.at(i).push_back(Agent_Combination{ combination });
-		}
-	}
 
 	// Record largest progression/diff towards a single goal/combination
-	for (auto& [key, val] : goals) {
+	for (auto id : goal_ids) {
+		const auto& key = goal_registry->get_goal(id);
+		auto& val = goals.at(id);
 		// Skip irrelevant goals and initial state
 		// TODO - The skip irrelevant part should be replaced by new system which replaces
 		// empty entries with the last non-empty entry
@@ -115,7 +220,7 @@ float Sliding_Recogniser::update_non_probabilities(size_t base_window_index, siz
 			window_length += 1;
 		}
 
-		float absolute_progress = (float)val.lengths.at(window_index) - (val.lengths.at(time_step - 1));
+		float absolute_progress = (float)val.at(window_index) - (val.at(time_step - 1));
 		float progress = absolute_progress / window_length;
 
 		progress = std::max(std::min(progress, 1.0f), 0.0f);
@@ -123,20 +228,18 @@ float Sliding_Recogniser::update_non_probabilities(size_t base_window_index, siz
 		for (auto& agent : key.agents.get()) {
 			bool is_useful = true;
 			auto agent_prob = val.probability;
-			for (size_t i = 0; i < agent_permutations.size(); ++i) {
-				for (const auto& permutation : agent_permutations.at(i)) {
-					
-					if (permutation.contains(agent)) {
-						continue;
-					}
-					auto possible_handoff_agents = permutation.get();
-					possible_handoff_agents.push_back(EMPTY_VAL);
-					for (const auto& handoff_agent : possible_handoff_agents) {
-						auto it = goals.find(Goal(Agent_Combination{ permutation }, key.recipe, handoff_agent));
-						if (it != goals.end() && it->second.is_current(time_step) && it->second.probability >= agent_prob * delta) {
-							is_useful = false;
-							break;
-						}
+			for (const auto& permutation : agent_combinations) {
+				
+				if (permutation.contains(agent)) {
+					continue;
+				}
+				auto possible_handoff_agents = permutation.get();
+				possible_handoff_agents.push_back(EMPTY_VAL);
+				for (const auto& handoff_agent : possible_handoff_agents) {
+					auto other = find(Goal(Agent_Combination{ permutation }, key.recipe, handoff_agent));
+					if (other != nullptr && other->is_current(time_step) && other->probability >= agent_prob * delta) {
+						is_useful = false;
+						break;
 					}
 				}
 			}
@@ -173,23 +276,27 @@ float Sliding_Recogniser::update_non_probabilities(size_t base_window_index, siz
 		max_prob = std::max(max_prob, progress_prob);
 
 		Goal goal{  agent, EMPTY_RECIPE, EMPTY_VAL};
-		goals.at(goal).probability = progress_prob;
-		goals.at(goal).progress_prob = progress_prob;
+		auto& entry = goals.at(goal_registry->get_id(goal));
+		entry.probability = progress_prob;
+		entry.progress_prob = progress_prob;
 	}
 
 	return max_prob;
 }
 
 void Sliding_Recogniser::normalise(float max_prob) {
-	for (auto& [key, val] : goals) {
+	for (auto id : goal_ids) {
+		const auto& key = goal_registry->get_goal(id);
+		auto& val = goals.at(id);
 		val.probability /= max_prob;
 	}
 }
 
 
 
-void Sliding_Recogniser::update(const std::map<Goal, size_t>& goal_lengths, const State& state) {
+void Sliding_Recogniser::update(const std::vector<size_t>& goal_lengths, const State& state) {
 	++time_step;
+	evict_stale_goals();
 	insert(goal_lengths, state);
 
 
@@ -203,7 +310,9 @@ void Sliding_Recogniser::update(const std::map<Goal, size_t>& goal_lengths, cons
 Goal Sliding_Recogniser::get_goal(Agent_Id agent) {
 	float best_prob = EMPTY_PROB;
 	Goal best_goal = {};
-	for (const auto& [key, val]: goals) {
+	for (auto id : goal_ids) {
+		const auto& key = goal_registry->get_goal(id);
+		const auto& val = goals.at(id);
 		if (val.probability > best_prob && key.agents.contains(agent)) {
 			best_prob = val.probability;
 			best_goal = key;
@@ -215,7 +324,9 @@ Goal Sliding_Recogniser::get_goal(Agent_Id agent) {
 std::map<Agent_Id, Goal> Sliding_Recogniser::get_goals() const {
 	std::map<Agent_Id, Goal> result;
 	std::map<Agent_Id, float> probs;
-	for (const auto& [key, val] : goals) {
+	for (auto id : goal_ids) {
+		const auto& key = goal_registry->get_goal(id);
+		const auto& val = goals.at(id);
 		for (const auto& agent : key.agents.get()) {
 			auto it = result.find(agent);
 			if (it == result.end()) {
@@ -237,11 +348,11 @@ std::map<Goal, float> Sliding_Recogniser::get_raw_goals() const {
 
 // False if subset of agents is as likely, true otherwise
 bool Sliding_Recogniser::is_probable(Goal goal_input) const {
-	auto it_input = goals.find(goal_input);
-	if (it_input == goals.end()) {
+	auto entry = find(goal_input);
+	if (entry == nullptr) {
 		return false;
 	}
-	auto probability = it_input->second.probability;
+	auto probability = entry->probability;
 
 	if (probability < charlie) {
 		return false;
@@ -261,15 +372,32 @@ bool Sliding_Recogniser::is_probable(Goal goal_input) const {
 }
 
 float Sliding_Recogniser::get_non_probability(Agent_Id agent) const {
-	return goals.at(Goal(agent, EMPTY_RECIPE, EMPTY_VAL)).probability;
+	return goals.at(goal_registry->get_id(Goal(agent, EMPTY_RECIPE, EMPTY_VAL))).probability;
 }
 
-bool Sliding_Recogniser::is_probable_normalised(Goal goal, const std::vector<Goal>& available_goals, 
+// Highest probability among the available goals of each agent, 0 if the agent has none
+std::vector<float> Sliding_Recogniser::get_normalisers(const std::vector<Goal>& available_goals) const {
+	std::vector<float> normalisers(environment.get_number_of_agents(), 0.0f);
+	for (const auto& goal : available_goals) {
+		auto entry = find(goal);
+		if (entry == nullptr) {
+			continue;
+		}
+		for (const auto& agent : goal.agents) {
+			auto& normaliser = normalisers.at(agent.id);
+			if (entry->probability > normaliser) {
+				normaliser = entry->probability;
+			}
+		}
+	}
+	return normalisers;
+}
+
+bool Sliding_Recogniser::is_probable_normalised(Goal goal, const std::vector<float>& normalisers,
 	Agent_Id acting_agent, Agent_Id planning_agent, bool use_non_probability) const {
 
-	float highest_prob = 0.0f;
-	auto it = goals.find(goal);
-	if (it == goals.end()) {
+	auto entry = find(goal);
+	if (entry == nullptr) {
 		return false;
 	}
 
@@ -279,17 +407,8 @@ bool Sliding_Recogniser::is_probable_normalised(Goal goal, const std::vector<Goa
 			return false;
 		}
 	}
-	
 
-	for (const auto& goal : available_goals) {
-		if (!goal.agents.contains(acting_agent)) {
-			continue;
-		}
-		auto inner_it = goals.find(goal);
-		if (inner_it != goals.end() && inner_it->second.probability > highest_prob) {
-			highest_prob = inner_it->second.probability;
-		}
-	}
+	float highest_prob = normalisers.at(acting_agent.id);
 
 	// Check none-probability
 	if (use_non_probability) {
@@ -303,7 +422,7 @@ bool Sliding_Recogniser::is_probable_normalised(Goal goal, const std::vector<Goa
 		return false;
 	}
 
-	auto normalised_prob = it->second.probability / highest_prob;
+	auto normalised_prob = entry->probability / highest_prob;
 
 	std::stringstream buffer;
 	buffer << std::setprecision(3);
@@ -324,16 +443,18 @@ bool Sliding_Recogniser::is_probable_normalised(Goal goal, const std::vector<Goa
 }
 
 float Sliding_Recogniser::get_probability(const Goal& goal) const {
-	auto it = goals.find(goal);
-	if (it == goals.end()) {
+	auto entry = find(goal);
+	if (entry == nullptr) {
 		return 0.0f;
 	} else {
-		return it->second.probability;
+		return entry->probability;
 	}
 }
 
 void Sliding_Recogniser::print_probabilities() const {
-	for (const auto& [key, val] : goals) {
+	for (auto id : goal_ids) {
+		const auto& key = goal_registry->get_goal(id);
+		const auto& val = goals.at(id);
 		if (!val.is_current(time_step)) continue;
 		PRINT(Print_Category::RECOGNISER, Print_Level::DEBUG, 
 			static_cast<char>(key.recipe.result) + 
@@ -346,7 +467,9 @@ void Sliding_Recogniser::print_probabilities() const {
 	for (auto& buffer : buffers) {
 		buffer << std::fixed << std::setprecision(3) << '\n';
 	}
-	for (const auto& [key, val] : goals) {
+	for (auto id : goal_ids) {
+		const auto& key = goal_registry->get_goal(id);
+		const auto& val = goals.at(id);
 		if (!val.is_current(time_step)) continue;
 		buffers.at(0) << val.length_prob << "\t";
 		buffers.at(1) << val.progress_prob << "\t";
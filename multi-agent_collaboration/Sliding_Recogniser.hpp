@@ -1,79 +1,144 @@
 #pragma once
 
+#include "Goal_Registry.hpp"
 #include "Recogniser.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdint>
 #include <map>
+#include <memory>
 #include <vector>
 
+constexpr size_t WINDOW_SIZE = 4;
+
+// Goal lengths of each time step, only the last WINDOW_SIZE steps are stored in a ring buffer.
+// Steps before the first length of the goal are EMPTY_VAL.
 struct Goal_Entry {
-	Goal_Entry() : probability(EMPTY_PROB), lengths(),
-		length_prob(EMPTY_PROB), progress_prob(EMPTY_PROB) {}
+	Goal_Entry() : probability(EMPTY_PROB), lengths(), size(0), first_non_empty(EMPTY_VAL), last_seen(0),
+		is_tracked(false), length_prob(EMPTY_PROB), progress_prob(EMPTY_PROB) {}
 
-	Goal_Entry(size_t length, size_t time_step) : probability(EMPTY_PROB), lengths(),
+	Goal_Entry(size_t length, size_t time_step) : probability(EMPTY_PROB), lengths(), size(0),
+		first_non_empty(EMPTY_VAL), last_seen(time_step), is_tracked(false),
 		length_prob(EMPTY_PROB), progress_prob(EMPTY_PROB) {
 		add(length, time_step);
 	};
 	
 	void repeat(size_t time_step) {
-		if (lengths.empty()) {
+		if (size == 0) {
 			if (time_step > 0) {
-				lengths.push_back(EMPTY_VAL);
+				push(EMPTY_VAL);
 			} else {
 				return;
 			}
 		}
-		size_t val = lengths.back();
-		while (lengths.size() < time_step) {
-			lengths.push_back(val);
+		size_t val = back();
+
+		// Steps which would be overwritten before being read are skipped
+		if (time_step > size + WINDOW_SIZE) {
+			size = time_step - WINDOW_SIZE;
+		}
+		while (size < time_step) {
+			push(val);
 		}
 	}
 
 	void add(size_t length, size_t time_step) {
 		repeat(time_step - 1);
-		lengths.push_back(length);
+		push(length);
+	}
+
+	size_t at(size_t index) const {
+		assert(index < size && index + WINDOW_SIZE >= size);
+		return lengths[index % WINDOW_SIZE];
+	}
+
+	size_t back() const {
+		return at(size - 1);
 	}
 
 	size_t get_non_empty_index(size_t index) const {
-		while (index < lengths.size() && lengths.at(index) == EMPTY_VAL) {
+		index = std::max(index, first_non_empty);
+		while (index < size && at(index) == EMPTY_VAL) {
 			++index;
 		}
-		return index >= lengths.size() || lengths.empty() ? EMPTY_VAL : index;
+		return index >= size ? EMPTY_VAL : index;
 	}
 
 	bool is_current(size_t time_step) const {
-		assert(lengths.size() <= time_step);
-		return lengths.size() == time_step || lengths.size() == 0; // NONE goal has size==0
+		assert(size <= time_step);
+		return size == time_step || size == 0; // NONE goal has size==0
 	}
 
 	float probability;
-	std::vector<size_t> lengths;
+	std::array<size_t, WINDOW_SIZE> lengths;
+	size_t size;				// Time steps recorded, including the ones no longer stored
+	size_t first_non_empty;		// Time step of the first length, EMPTY_VAL if none
+	size_t last_seen;			// Time step the goal was last given a length
+	bool is_tracked;			// If the recogniser holds the goal
 
 	// For debug
 	float length_prob;
 	float progress_prob;
+
+private:
+	void push(size_t length) {
+		if (length != EMPTY_VAL && first_non_empty == EMPTY_VAL) {
+			first_non_empty = size;
+		}
+		lengths[size % WINDOW_SIZE] = length;
+		++size;
+	}
+};
+
+// Structure of arrays of the current goals, for the batched probability update
+struct Probability_Batch {
+	void clear() {
+		ids.clear();
+		old_lengths.clear();
+		progress_lengths.clear();
+		new_goal_masks.clear();
+	}
+
+	std::vector<size_t> ids;
+	std::vector<float> old_lengths;			// Length at the start of the window
+	std::vector<float> progress_lengths;	// Current length + window length
+	std::vector<int32_t> new_goal_masks;	// All bits set if the window is empty
+	std::vector<float> length_probs;
+	std::vector<float> progress_probs;
+	std::vector<float> probabilities;
 };
 
 class Sliding_Recogniser : public Recogniser_Method {
 public:
-	Sliding_Recogniser(const Environment& environment, const State& initial_state);
-	void update(const std::map<Goal, size_t>& goal_lengths, const State& state) override;
+	Sliding_Recogniser(const Environment& environment, const State& initial_state,
+		std::shared_ptr<const Goal_Registry> goal_registry, size_t max_coalition_size = EMPTY_VAL);
+	void update(const std::vector<size_t>& goal_lengths, const State& state) override;
 	Goal get_goal(Agent_Id agent) override;
 	std::map<Goal, float> get_raw_goals() const override;
 	bool is_probable(Goal goal) const override;
-	bool is_probable_normalised(Goal goal, const std::vector<Goal>& available_goals, Agent_Id agent, Agent_Id planning_agent, bool use_non_probability) const override;
+	std::vector<float> get_normalisers(const std::vector<Goal>& available_goals) const override;
+	bool is_probable_normalised(Goal goal, const std::vector<float>& normalisers, Agent_Id agent, Agent_Id planning_agent, bool use_non_probability) const override;
 	std::map<Agent_Id, Goal> get_goals() const override;
 	void print_probabilities() const override;
 	float get_probability(const Goal& goal) const override;
 
 private:
 	float get_non_probability(Agent_Id agent) const;
-	void insert(const std::map<Goal, size_t>& goal_lengths, const State& state);
+	const Goal_Entry* find(const Goal& goal) const;
+	void track(size_t id, const Goal_Entry& entry);
+	void insert(const std::vector<size_t>& goal_lengths, const State& state);
+	void evict_stale_goals();
 	float update_standard_probabilities(size_t base_window_index);
 	float update_non_probabilities(size_t base_window_index, size_t number_of_agents);
 	void normalise(float max_prob);
 
 	//std::vector<std::vector<bool>> agents_active_status;
-	std::map<Goal, Goal_Entry> goals;
+	std::shared_ptr<const Goal_Registry> goal_registry;
+	std::vector<Goal_Entry> goals;		// Indexed by goal id
+	std::vector<size_t> goal_ids;		// Sorted ids of the tracked goals
+	Probability_Batch probability_batch;
 	size_t time_step;
+	std::vector<Agent_Combination> agent_combinations;
 };
\ No newline at end of file
@@ -22,6 +22,17 @@ std::vector<Agent_Combination> get_combinations(size_t n) {
 	return get_combinations(vec);
 }
 
+// Get all combinations of numbers/agents <n with at most max_size entries
+std::vector<Agent_Combination> get_combinations(size_t n, size_t max_size) {
+	auto combinations = get_combinations(n);
+	if (max_size < n) {
+		combinations.erase(std::remove_if(combinations.begin(), combinations.end(),
+			[max_size](const Agent_Combination& combination) { return combination.size() > max_size; }),
+			combinations.end());
+	}
+	return combinations;
+}
+
 // All combinations of all sizes
 std::vector<Agent_Combination> get_combinations(std::vector<size_t> agents) {
 	if (agents.empty()) return {};
@@ -6,6 +6,7 @@
 #include "Environment.hpp"
 
 std::vector<Agent_Combination> get_combinations(size_t n);
+std::vector<Agent_Combination> get_combinations(size_t n, size_t max_size);
 std::vector<Agent_Combination> get_combinations(std::vector<size_t> agents);
 std::vector<Agent_Combination> get_combinations(Agent_Combination agents);
 std::vector<Agent_Combination> get_permutations(Agent_Combination agents);
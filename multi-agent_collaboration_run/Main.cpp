@@ -1,5 +1,6 @@
 
 #include "Environment.hpp"
+#include "Heuristic_Cache.hpp"
 #include "Planner.hpp"
 #include "Planner_Mac.hpp"
 #include "Planner_Mac_One.hpp"
@@ -13,6 +14,7 @@
 #include <fstream>
 
 #define PLAY 0
+#define HEURISTIC_CACHE 0
 
 std::vector<std::string> get_all_files(std::string base_path) {
 	std::vector<std::string> paths;
@@ -229,6 +231,9 @@ void solve() {
 
 int main(int argc, char* argv[]) {
 	int x;
+	if (HEURISTIC_CACHE) {
+		set_heuristic_cache_directory("../heuristic_cache");
+	}
 	if (PLAY) {
 		auto environment = Environment(2);
 		auto state = environment.load("../levels/BD/full-divider_salad.txt");
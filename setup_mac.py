@@ -8,9 +8,15 @@ module1 = Extension('mac_interface',
                                'multi-agent_collaboration/BFS.cpp',
                                'multi-agent_collaboration/Core.cpp',
                                'multi-agent_collaboration/Environment.cpp',
+                               'multi-agent_collaboration/Free_Wall_Field.cpp',
+                               'multi-agent_collaboration/Goal_Registry.cpp',
                                'multi-agent_collaboration/Heuristic.cpp',
+                               'multi-agent_collaboration/Heuristic_Cache.cpp',
+                               'multi-agent_collaboration/Pattern_Database.cpp',
                                'multi-agent_collaboration/Planner_Mac.cpp',
                                'multi-agent_collaboration/Planner_Still.cpp',
+                               'multi-agent_collaboration/Reachability.cpp',
+                               'multi-agent_collaboration/Reservation_Table.cpp',
                                'multi-agent_collaboration/Search_Trimmer.cpp',
                                'multi-agent_collaboration/Sliding_Recogniser.cpp',
                                'multi-agent_collaboration/State.cpp',